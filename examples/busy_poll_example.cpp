@@ -0,0 +1,101 @@
+#include "buffio/shard.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sys/socket.h>
+#include <vector>
+
+/*
+ * ping-pong between two shards over a unix socketpair, the round trip
+ * latency is measured with the busy-poll mode off and on.
+ */
+
+#define ROUNDS 20000
+
+struct pingPong {
+  long budget;
+  int fds[2];
+  std::vector<long> rtt;
+  buffio::busyPollStats stats[2];
+};
+
+buffio::promise pinger(pingPong *info) {
+  buffio::Fd fd;
+  struct sockaddr addr = {0};
+  addr.sa_family = AF_UNIX;
+  buffio::MakeFd::mkFdSock(fd, info->fds[0], addr);
+
+  char byte = 'p';
+  for (int i = 0; i < ROUNDS; i++) {
+    auto start = std::chrono::steady_clock::now();
+    __buffioCall(fd.waitWrite(&byte, 1));
+    do {
+      __buffioCall(fd.waitRead(&byte, 1));
+    } while (fd.syncHeaders().headerA->len.len <= 0);
+    auto end = std::chrono::steady_clock::now();
+    info->rtt.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count());
+  };
+  info->stats[0] = buffio::fiber::loop->busyStats();
+  buffioreturn 0;
+};
+
+buffio::promise ponger(pingPong *info) {
+  buffio::Fd fd;
+  struct sockaddr addr = {0};
+  addr.sa_family = AF_UNIX;
+  buffio::MakeFd::mkFdSock(fd, info->fds[1], addr);
+
+  char byte = 0;
+  for (int i = 0; i < ROUNDS; i++) {
+    // a read can complete empty on a stale readiness, wait again then.
+    do {
+      __buffioCall(fd.waitRead(&byte, 1));
+    } while (fd.syncHeaders().headerA->len.len <= 0);
+    __buffioCall(fd.waitWrite(&byte, 1));
+  };
+  info->stats[1] = buffio::fiber::loop->busyStats();
+  buffioreturn 0;
+};
+
+int setup(buffio::scheduler &loop, int shardId, void *data) {
+  pingPong *info = (pingPong *)data;
+  loop.busyPoll(info->budget);
+  if (shardId == 0)
+    loop.push(pinger(info));
+  else
+    loop.push(ponger(info));
+  return 0;
+};
+
+static void bench(long budget) {
+  pingPong info;
+  info.budget = budget;
+  info.rtt.reserve(ROUNDS);
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, info.fds) != 0)
+    return;
+
+  buffio::shards runtime;
+  if (runtime.start(2, setup, &info) != 0) {
+    std::cout << "failed to start shards" << std::endl;
+    return;
+  };
+  runtime.join();
+
+  if (info.rtt.empty())
+    return;
+  std::sort(info.rtt.begin(), info.rtt.end());
+  size_t n = info.rtt.size();
+  std::cout << "[busy poll " << budget << "us] rtt p50 "
+            << info.rtt[n / 2] / 1000.0 << "us p99 "
+            << info.rtt[n * 99 / 100] / 1000.0 << "us, spin hits "
+            << info.stats[0].hits + info.stats[1].hits << " misses "
+            << info.stats[0].misses + info.stats[1].misses << std::endl;
+};
+
+int main() {
+  bench(0);
+  bench(50);
+  return 0;
+};
@@ -0,0 +1,54 @@
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+
+/*
+ * a protocol parser split into nested routines, every level awaits the
+ * next one. an awaited routine runs right away in the place of its caller
+ * and its completion resumes the caller directly, a routine queued behind
+ * the parser only gets a turn every BUFFIO_INLINE_SWITCHES switches.
+ */
+
+#define DEPTH 8
+#define MESSAGES 100000
+
+static size_t fields = 0;
+
+buffio::promise parseField(int depth) {
+  if (depth > 0)
+    buffiowait parseField(depth - 1);
+  fields += 1;
+  buffioreturn 0;
+};
+
+buffio::promise parser() {
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < MESSAGES; i++)
+    buffiowait parseField(DEPTH - 1);
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+  std::cout << fields << " nested awaits in " << ns / 1000 << "us, "
+            << ns / (MESSAGES * DEPTH) << "ns per level" << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise bystander() {
+  std::cout << "bystander ran after " << fields << " of "
+            << MESSAGES * DEPTH << " nested awaits" << std::endl;
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  loop.push(parser());
+  loop.push(bystander());
+  loop.run();
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,81 @@
+#include "buffio/cancel.hpp"
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+
+/*
+ * a request reads a pipe nobody writes to and sleeps 10s in parallel, an
+ * upstream timeout cancels it after 50ms. the pending read and the timer
+ * are aborted, the request is done after about 50ms and the loop exits
+ * right away instead of waiting on the read or the timer.
+ */
+
+static std::chrono::steady_clock::time_point begin;
+
+static long elapsed() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+};
+
+buffio::promise reader(buffio::Fd *fd) {
+  char buffer[64];
+  buffiowait fd->waitRead(buffer, sizeof(buffer));
+  std::cout << "  reader resumed after " << elapsed() << "ms, "
+            << (fd->readError() == (int)buffioErrorCode::cancelled
+                    ? "cancelled"
+                    : "read")
+            << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise sleeper(uint32_t ms) {
+  buffiowait buffio::clockSpec::wait{ms};
+  std::cout << "  sleeper resumed after " << elapsed() << "ms, cancelled "
+            << buffio::cancelled() << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise request(buffio::cancelToken token) {
+  buffiowait token;
+
+  buffio::Fd pipe;
+  if (buffio::MakeFd::pipe(pipe) != 0) {
+    std::cout << "failed to create the pipe" << std::endl;
+    buffioreturn -1;
+  };
+
+  buffiowait buffio::whenAll(reader(&pipe), sleeper(10000));
+  std::cout << "  request done after " << elapsed() << "ms" << std::endl;
+
+  // the scope stays cancelled, later waits give up right away.
+  buffiowait buffio::clockSpec::wait{10000};
+  std::cout << "  wait after the cancel returned after " << elapsed() << "ms"
+            << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise timeout(buffio::cancelSource *source, uint32_t ms) {
+  buffiowait buffio::clockSpec::wait{ms};
+  std::cout << "  timeout, " << source->cancel() << " waits aborted"
+            << std::endl;
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  buffio::cancelSource source;
+  begin = std::chrono::steady_clock::now();
+  loop.push(request(source.token()));
+  loop.push(timeout(&source, 50));
+  loop.run();
+  std::cout << "loop exited after " << elapsed() << "ms" << std::endl;
+  loop.clean();
+  return 0;
+};
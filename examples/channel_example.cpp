@@ -0,0 +1,141 @@
+#include "buffio/channel.hpp"
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+/*
+ * one million integers pushed through a bounded queue of 64 slots:
+ * - between two routines of one loop with buffio::channel,
+ * - from a thread to a routine with buffio::threadChannel,
+ * - between two threads with a mutex and condition variable queue, the
+ *   usual way to do it without buffio.
+ */
+
+#define MESSAGES 1000000
+#define CAPACITY 64
+
+static std::chrono::steady_clock::time_point begin;
+
+static void report(const char *name, size_t sum) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+  std::cout << name << ": " << MESSAGES << " messages in " << ns / 1000000
+            << "ms, " << ns / MESSAGES << "ns per message (sum " << sum << ")"
+            << std::endl;
+};
+
+buffio::promise sender(buffio::channel<size_t> *chan) {
+  for (size_t i = 0; i < MESSAGES; i++)
+    buffiowait chan->send(i);
+  chan->close();
+  buffioreturn 0;
+};
+
+buffio::promise receiver(buffio::channel<size_t> *chan) {
+  size_t sum = 0;
+  while (std::optional<size_t> value = buffiowait chan->recv())
+    sum += *value;
+  report("channel, routine to routine", sum);
+  buffioreturn 0;
+};
+
+buffio::promise local() {
+  buffio::channel<size_t> chan(CAPACITY);
+  buffio::taskGroup group;
+  begin = std::chrono::steady_clock::now();
+  group.spawn(receiver(&chan));
+  group.spawn(sender(&chan));
+  buffiowait group.all();
+  buffioreturn 0;
+};
+
+buffio::promise threadReceiver(buffio::threadChannel<size_t> *chan) {
+  size_t sum = 0;
+  while (std::optional<size_t> value = buffiowait chan->recv())
+    sum += *value;
+  report("threadChannel, thread to routine", sum);
+  buffioreturn 0;
+};
+
+static void threadSender(buffio::threadChannel<size_t> *chan) {
+  for (size_t i = 0; i < MESSAGES;) {
+    if (chan->send(i) == 0)
+      i += 1;
+    else
+      std::this_thread::yield();
+  };
+  chan->close();
+};
+
+struct lockedQueue {
+  std::mutex lock;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  std::deque<size_t> items;
+  bool closed = false;
+};
+
+static void lockedBenchmark() {
+  lockedQueue queue;
+  begin = std::chrono::steady_clock::now();
+
+  std::thread producer([&queue]() {
+    for (size_t i = 0; i < MESSAGES; i++) {
+      std::unique_lock<std::mutex> guard(queue.lock);
+      queue.notFull.wait(guard,
+                         [&queue]() { return queue.items.size() < CAPACITY; });
+      queue.items.push_back(i);
+      queue.notEmpty.notify_one();
+    };
+    std::lock_guard<std::mutex> guard(queue.lock);
+    queue.closed = true;
+    queue.notEmpty.notify_one();
+  });
+
+  size_t sum = 0;
+  for (;;) {
+    std::unique_lock<std::mutex> guard(queue.lock);
+    queue.notEmpty.wait(
+        guard, [&queue]() { return !queue.items.empty() || queue.closed; });
+    if (queue.items.empty())
+      break;
+    sum += queue.items.front();
+    queue.items.pop_front();
+    queue.notFull.notify_one();
+  };
+  producer.join();
+  report("mutex + condvar, thread to thread", sum);
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  loop.push(local());
+  loop.run();
+
+  buffio::threadChannel<size_t> chan;
+  if (chan.init(loop, 6) != 0) {
+    std::cout << "failed to init the channel" << std::endl;
+    return 1;
+  };
+  begin = std::chrono::steady_clock::now();
+  loop.push(threadReceiver(&chan));
+  std::thread producer(threadSender, &chan);
+  loop.run();
+  producer.join();
+  std::cout << "  " << loop.postWakeups() << " eventfd writes" << std::endl;
+
+  lockedBenchmark();
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,55 @@
+#include "buffio/fd.hpp"
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+
+/*
+ * a large burst of tiny file reads on two sockBroker workers: every worker
+ * hands its completions back to the loop in chains, with one eventfd
+ * signal per chain instead of one per request.
+ */
+
+#define READS 200
+
+buffio::promise readOnce(size_t *done) {
+  buffio::Fd fd;
+  char buffer[64];
+  if (buffio::MakeFd::openFile(fd, "/dev/zero", O_RDONLY) != 0)
+    buffioreturn 1;
+  __buffioCall(fd.waitRead(buffer, sizeof(buffer)));
+  *done += 1;
+  buffioreturn 0;
+};
+
+buffio::promise burst(buffio::scheduler *loop) {
+  size_t done = 0;
+  auto begin = std::chrono::steady_clock::now();
+  buffio::taskGroup group;
+  for (int i = 0; i < READS; i++)
+    group.spawn(readOnce(&done));
+  buffiowait group.all();
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+
+  auto stats = loop->completionStats();
+  std::cout << done << " reads in " << us << "us" << std::endl;
+  std::cout << stats.completed << " completions in " << stats.batches
+            << " batches, " << stats.signals << " eventfd signals"
+            << std::endl;
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop(2, 8);
+  if (loop.error()) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+  loop.push(burst(&loop));
+  loop.run();
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,113 @@
+#include "buffio/coroutine.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/*
+ * - blocking style code run as a fiber: a plain function reads a pipe and
+ *   sleeps, the loop keeps running the routine feeding the pipe.
+ * - switch cost, a fiber yielding to the loop against a routine doing the
+ *   same through promise::run.
+ * - 10000 fibers created in waves of 100, stacks are reused from the pool.
+ */
+
+#define SWITCHES 1000000
+#define FIBERS 10000
+#define WAVE 100
+
+static std::chrono::steady_clock::time_point begin;
+
+static long elapsedNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+};
+
+// written as blocking code, nothing in it is a coroutine.
+static void legacyReader(void *data) {
+  auto pipe = (buffio::Fd *)data;
+  char line[6];
+  for (int lines = 0; lines < 3;) {
+    line[0] = 0;
+    buffio::coro::wait(pipe->waitRead(line, sizeof(line)));
+    if (pipe->readError() != 0)
+      return;
+    // woken with nothing read yet, wait again.
+    if (line[0] == 0)
+      continue;
+    std::cout << "fiber read \"" << std::string(line, sizeof(line)) << "\""
+              << std::endl;
+    lines += 1;
+    buffio::coro::sleep(5);
+  };
+};
+
+buffio::promise feeder(buffio::Fd *pipe) {
+  const char *lines[3] = {"line-0", "line-1", "line-2"};
+  for (int i = 0; i < 3; i++) {
+    buffiowait buffio::clockSpec::wait{10};
+    (void)::write(pipe->getPipeWrite(), lines[i], strlen(lines[i]));
+  };
+  buffioreturn 0;
+};
+
+static void fiberYielder(void *data) {
+  for (int i = 0; i < SWITCHES; i++)
+    buffio::coro::yield();
+};
+
+buffio::promise routineYielder() {
+  for (int i = 0; i < SWITCHES; i++)
+    buffioyeild i;
+  buffioreturn 0;
+};
+
+static void sleeper(void *data) {
+  buffio::coro::sleep(1);
+  *(size_t *)data += 1;
+};
+
+static void spawnWave(void *data) {
+  for (int i = 0; i < WAVE; i++)
+    buffio::fiber::loop->push(buffio::coro::make(sleeper, data));
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  buffio::Fd pipe;
+  if (buffio::MakeFd::pipe(pipe) != 0)
+    return 1;
+  loop.push(buffio::coro::make(legacyReader, &pipe));
+  loop.push(feeder(&pipe));
+  loop.run();
+
+  begin = std::chrono::steady_clock::now();
+  loop.push(buffio::coro::make(fiberYielder, nullptr));
+  loop.run();
+  long fiberNs = elapsedNs();
+
+  begin = std::chrono::steady_clock::now();
+  loop.push(routineYielder());
+  loop.run();
+  long routineNs = elapsedNs();
+  std::cout << "yield to the loop and back: fiber " << fiberNs / SWITCHES
+            << "ns, routine " << routineNs / SWITCHES << "ns" << std::endl;
+
+  size_t done = 0;
+  for (int wave = 0; wave < FIBERS / WAVE; wave++) {
+    loop.push(spawnWave, &done);
+    loop.run();
+  };
+  auto &stats = loop.stackStats();
+  std::cout << done << " fibers, " << stats.maps << " stacks mapped, "
+            << stats.reuses << " reused" << std::endl;
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,102 @@
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/*
+ * one read on an idle pipe times out after 100ms, one read with a 500ms
+ * deadline is served after 50ms and its deadline is dropped, the loop
+ * exits right after instead of waiting for it. then 100k deadlines are
+ * armed and disarmed, the way idle connections re-arm on every request.
+ */
+
+#define CONNECTIONS 100000
+
+static std::chrono::steady_clock::time_point begin;
+
+static long elapsed() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+};
+
+static const char *outcome(int error) {
+  if (error == (int)buffioErrorCode::timeout)
+    return "timed out";
+  if (error == (int)buffioErrorCode::cancelled)
+    return "cancelled";
+  return "read";
+};
+
+buffio::promise idle() {
+  buffio::Fd pipe;
+  if (buffio::MakeFd::pipe(pipe) != 0)
+    buffioreturn -1;
+
+  char buffer[64];
+  buffiowait pipe.waitRead(buffer, sizeof(buffer),
+                           buffio::clockSpec::timeout{100});
+  std::cout << "  idle pipe " << outcome(pipe.readError()) << " after "
+            << elapsed() << "ms" << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise writer(buffio::Fd *pipe) {
+  buffiowait buffio::clockSpec::wait{50};
+  char message[] = "hello";
+  (void)::write(pipe->getPipeWrite(), message, sizeof(message));
+  buffioreturn 0;
+};
+
+buffio::promise busy() {
+  buffio::Fd pipe;
+  if (buffio::MakeFd::pipe(pipe) != 0)
+    buffioreturn -1;
+
+  buffio::taskGroup group;
+  group.spawn(writer(&pipe));
+  char buffer[64] = {0};
+  buffiowait pipe.waitRead(buffer, sizeof(buffer),
+                           buffio::clockSpec::timeout{500});
+  std::cout << "  busy pipe " << outcome(pipe.readError()) << " \"" << buffer
+            << "\" after " << elapsed() << "ms" << std::endl;
+  buffiowait group.all();
+  buffioreturn 0;
+};
+
+static void rearm() {
+  buffio::Clock clock;
+  std::vector<buffioHeader> headers(CONNECTIONS, buffioHeader());
+
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < 10; round++) {
+    for (auto &header : headers)
+      clock.arm(&header, 30000 + round);
+    for (auto &header : headers)
+      clock.disarm(&header);
+  };
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  std::cout << "  " << CONNECTIONS << " deadlines armed and disarmed 10 times, "
+            << ns / (CONNECTIONS * 10) << "ns per pair" << std::endl;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  begin = std::chrono::steady_clock::now();
+  loop.push(idle());
+  loop.push(busy());
+  loop.run();
+  std::cout << "loop exited after " << elapsed() << "ms" << std::endl;
+  loop.clean();
+
+  rearm();
+  return 0;
+};
@@ -0,0 +1,64 @@
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+
+/*
+ * requests with growing latency budgets share the loop with routines that
+ * have no deadline. every request needs about 0.5ms of cpu in small
+ * slices, round-robin finishes them all late, earliest deadline first
+ * finishes each one within its budget.
+ */
+
+#define REQUESTS 8
+#define SLICES 100
+#define SLICE_US 5
+#define BUDGET_US 1000
+
+static void spin(long us) {
+  auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < until)
+    ;
+};
+
+buffio::promise request(int id) {
+  buffiowait buffio::clockSpec::deadline{(uint32_t)(BUDGET_US * (id + 1))};
+  for (int i = 0; i < SLICES; i++) {
+    spin(SLICE_US);
+    buffioyeild i;
+  };
+  buffioreturn 0;
+};
+
+buffio::promise bulk() {
+  for (int i = 0; i < SLICES * 2; i++) {
+    spin(SLICE_US);
+    buffioyeild i;
+  };
+  buffioreturn 0;
+};
+
+static void bench(buffioSchedPolicy policy, const char *name) {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return;
+  };
+  loop.setPolicy(policy);
+
+  loop.push(bulk());
+  loop.push(bulk());
+  for (int i = 0; i < REQUESTS; i++)
+    loop.push(request(i));
+
+  loop.run();
+  auto stats = loop.deadlineStats();
+  std::cout << "[" << name << "] deadlines met " << stats.met << " missed "
+            << stats.missed << std::endl;
+  loop.clean();
+};
+
+int main() {
+  bench(buffioSchedPolicy::priority, "priority");
+  bench(buffioSchedPolicy::edf, "edf");
+  return 0;
+};
@@ -0,0 +1,76 @@
+#include "buffio/fiber.hpp"
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+/*
+ * a burst of blocking jobs on the sockBroker workers of an elastic pool:
+ * workers are spawned while the queue stays deep, then retire once idle.
+ */
+
+#define JOBS 64
+
+static long elapsedMs(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+};
+
+static uint64_t checksum(size_t rounds) {
+  uint64_t hash = 1469598103934665603ULL;
+  for (size_t i = 0; i < rounds; i++)
+    hash = (hash ^ (i & 0xff)) * 1099511628211ULL;
+  return hash;
+};
+
+buffio::promise job(uint64_t *sum) {
+  buffio::fiber::clamper clamp;
+  buffiowait clamp.sclamp();
+  uint64_t hash = checksum(5000000);
+  buffiowait clamp.unclamp();
+  *sum ^= hash;
+  buffioreturn 0;
+};
+
+void report(const char *when, buffio::scheduler &loop) {
+  auto stats = loop.scalingStats();
+  std::cout << when << ": spawned " << stats.spawned << ", retired "
+            << stats.retired << ", peak " << stats.peak << " workers"
+            << std::endl;
+};
+
+buffio::promise burst(buffio::scheduler *loop) {
+  uint64_t sum = 0;
+  auto begin = std::chrono::steady_clock::now();
+  buffio::taskGroup group;
+  for (int i = 0; i < JOBS; i++)
+    group.spawn(job(&sum));
+  buffiowait group.all();
+  std::cout << JOBS << " jobs in " << elapsedMs(begin) << "ms" << std::endl;
+  report("after the burst", *loop);
+
+  // idle past the timeout, the spawned workers go away.
+  buffiowait buffio::clockSpec::wait{500};
+  report("after idling", *loop);
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop(2, 8);
+  buffio::workerScaling policy;
+  policy.minWorkers = 2;
+  policy.maxWorkers = 8;
+  policy.spawnDepth = 2;
+  policy.spawnAfterUs = 500;
+  policy.idleMs = 200;
+  if (loop.error() || loop.setScaling(policy) != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+  loop.push(burst(&loop));
+  loop.run();
+  loop.clean();
+  return 0;
+};
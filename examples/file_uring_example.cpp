@@ -0,0 +1,80 @@
+#include "buffio/fd.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+
+/*
+ * reads a file in 4 KiB blocks, once through the worker threads (epoll
+ * backend) and once through io_uring with a registered file and a buffer
+ * of the registered arena.
+ */
+
+#define FILE_PATH "./buffio_file_uring_test.bin"
+#define FILE_SIZE (16 * 1024 * 1024)
+#define BLOCK_SIZE 4096
+
+static size_t totalRead = 0;
+
+buffio::promise reader() {
+  buffio::Fd fd;
+
+  if (buffio::MakeFd::openFile(fd, FILE_PATH, O_RDONLY) != 0) {
+    std::cout << "failed to open " << FILE_PATH << std::endl;
+    buffioreturn 0;
+  };
+
+  char *buffer = buffio::fiber::loop->getBuffer();
+  for (;;) {
+    __buffioCall(fd.waitRead(buffer, BLOCK_SIZE));
+    ssize_t len = fd.syncHeaders().headerA->len.len;
+    if (len <= 0)
+      break;
+    totalRead += len;
+  };
+  buffio::fiber::loop->putBuffer(buffer);
+  buffioreturn 0;
+};
+
+static void bench(buffioBackend backend, const char *name) {
+  buffio::scheduler loop;
+  loop.setBackend(backend);
+  loop.setBuffers(BLOCK_SIZE, 16);
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return;
+  };
+
+  totalRead = 0;
+  loop.push(reader());
+  auto now = std::chrono::steady_clock::now();
+  loop.run();
+  auto end = std::chrono::steady_clock::now();
+  auto us =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - now).count();
+
+  std::cout << "[" << name << "] "
+            << (loop.backend() == buffioBackend::uring ? "io_uring" : "workers")
+            << " read " << totalRead << " bytes in " << us << " us, "
+            << (us > 0 ? (totalRead / us) : 0) << " MB/s" << std::endl;
+  loop.clean();
+};
+
+int main() {
+  FILE *file = ::fopen(FILE_PATH, "wb");
+  if (file == nullptr)
+    return 1;
+  char block[BLOCK_SIZE];
+  for (size_t i = 0; i < BLOCK_SIZE; i++)
+    block[i] = (char)('a' + i % 26);
+  for (size_t i = 0; i < FILE_SIZE / BLOCK_SIZE; i++)
+    ::fwrite(block, 1, BLOCK_SIZE, file);
+  ::fclose(file);
+
+  bench(buffioBackend::epoll, "epoll");
+  bench(buffioBackend::uring, "uring");
+
+  ::unlink(FILE_PATH);
+  return 0;
+};
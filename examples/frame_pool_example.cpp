@@ -0,0 +1,67 @@
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+
+/*
+ * an accept loop style churn: every iteration spawns a batch of short
+ * handlers and joins them, each handler frame is taken from and given
+ * back to the frame pool of the loop, the heap is only hit for the pages.
+ */
+
+#define ROUNDS 2000
+#define BATCH 64
+
+static size_t served = 0;
+
+buffio::promise handler(int fd) {
+  char scratch[200];
+  scratch[0] = (char)fd;
+  served += scratch[0] >= 0 ? 1 : 0;
+  buffioreturn 0;
+};
+
+buffio::promise bigHandler(int fd) {
+  char scratch[8192];
+  scratch[0] = (char)fd;
+  served += scratch[0] >= 0 ? 1 : 0;
+  buffioreturn 0;
+};
+
+buffio::promise acceptor() {
+  for (int round = 0; round < ROUNDS; round++) {
+    buffio::taskGroup group;
+    for (int i = 0; i < BATCH; i++)
+      group.spawn(handler(i));
+    buffiowait group.all();
+  };
+  buffiowait bigHandler(1);
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  auto begin = std::chrono::steady_clock::now();
+  loop.push(acceptor());
+  loop.run();
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+
+  auto &stats = loop.frameStats();
+  std::cout << served << " handlers in " << us << "us" << std::endl;
+  for (size_t i = 0; i < BUFFIO_FRAME_CLASSES; i++) {
+    if (stats.allocs[i] != 0)
+      std::cout << "  " << (64 << i) << " bytes class: " << stats.allocs[i]
+                << " frames" << std::endl;
+  };
+  std::cout << "  heap: " << stats.heap << " frames, largest " << stats.largest
+            << " bytes, " << stats.pages << " pages" << std::endl;
+  loop.clean();
+  return 0;
+};
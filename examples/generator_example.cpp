@@ -0,0 +1,113 @@
+#include "buffio/generator.hpp"
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+/*
+ * records parsed behind a pipe read are streamed to the consumer one by
+ * one, the producer suspends on the pipe first and on the consumer between
+ * records, a record is never copied or queued and the frame count stays
+ * the same whatever the number of records.
+ */
+
+#define BATCHES 1000
+#define BATCH 1000
+
+struct record {
+  uint32_t id;
+  uint32_t len;
+};
+
+buffio::generator<record> records(buffio::Fd *input) {
+  uint32_t header[2];
+  buffiowait input->waitRead((char *)header, sizeof(header));
+  if (input->readError() != 0)
+    throw std::runtime_error("pipe read failed");
+
+  // the header announces the batches, parsed in place.
+  record rec{.id = 0, .len = 0};
+  for (uint32_t batch = 0; batch < header[0]; batch++) {
+    for (uint32_t i = 0; i < header[1]; i++) {
+      rec.len = rec.id % 64;
+      buffioyeild rec;
+      rec.id += 1;
+    };
+  };
+};
+
+buffio::generator<int> counter(int limit) {
+  for (int i = 0; i < limit; i++)
+    buffioyeild i;
+  if (limit < 0)
+    throw std::runtime_error("negative limit");
+};
+
+buffio::promise feeder(buffio::Fd *output) {
+  buffiowait buffio::clockSpec::wait{10};
+  uint32_t header[2] = {BATCHES, BATCH};
+  (void)::write(output->getPipeWrite(), header, sizeof(header));
+  buffioreturn 0;
+};
+
+buffio::promise consumer() {
+  buffio::Fd pipe;
+  if (buffio::MakeFd::pipe(pipe) != 0)
+    buffioreturn -1;
+
+  buffio::taskGroup group;
+  group.spawn(feeder(&pipe));
+
+  size_t bytes = 0;
+  size_t count = 0;
+  auto begin = std::chrono::steady_clock::now();
+  auto stream = records(&pipe);
+  while (record *rec = buffiowait stream.next()) {
+    bytes += rec->len;
+    count += 1;
+  };
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+  std::cout << count << " records, " << bytes << " bytes in " << ns / 1000
+            << "us (10ms of it waiting on the pipe)" << std::endl;
+  buffiowait group.all();
+
+  // dropped half way, the producer is destroyed at its co_yield.
+  auto early = counter(10);
+  int sum = 0;
+  while (int *value = buffiowait early.next()) {
+    sum += *value;
+    if (*value == 4)
+      break;
+  };
+  std::cout << "stopped at sum " << sum << std::endl;
+
+  auto broken = counter(-1);
+  try {
+    buffiowait broken.next();
+  } catch (std::exception &e) {
+    std::cout << "stream threw: " << e.what() << std::endl;
+  };
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  loop.push(consumer());
+  loop.run();
+
+  auto &stats = loop.frameStats();
+  size_t frames = stats.heap;
+  for (size_t i = 0; i < BUFFIO_FRAME_CLASSES; i++)
+    frames += stats.allocs[i];
+  std::cout << frames << " frames allocated in total" << std::endl;
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,57 @@
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+
+/*
+ * three timer waits of 100, 200 and 300ms awaited together take about
+ * 300ms instead of 600ms, awaiting the first of them resumes after about
+ * 100ms with its slot, the others are cancelled right away.
+ */
+
+static std::chrono::steady_clock::time_point begin;
+
+static long elapsed() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+};
+
+buffio::promise fetch(uint32_t ms) {
+  buffiowait buffio::clockSpec::wait{ms};
+  buffioreturn 0;
+};
+
+buffio::promise parent() {
+  begin = std::chrono::steady_clock::now();
+  buffiowait buffio::whenAll(fetch(100), fetch(200), fetch(300));
+  std::cout << "all done after " << elapsed() << "ms" << std::endl;
+
+  begin = std::chrono::steady_clock::now();
+  ssize_t first = buffiowait buffio::whenAny(fetch(300), fetch(100), fetch(200));
+  std::cout << "slot " << first << " done first after " << elapsed() << "ms"
+            << std::endl;
+
+  buffio::taskGroup group;
+  for (uint32_t i = 0; i < 8; i++)
+    group.spawn(fetch(10 * (8 - i)));
+  begin = std::chrono::steady_clock::now();
+  buffiowait group.all();
+  std::cout << group.finished() << " of " << group.spawned()
+            << " grouped routines done after " << elapsed()
+            << "ms, first was slot " << group.first() << std::endl;
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  loop.push(parent());
+  loop.run();
+  loop.clean();
+  return 0;
+};
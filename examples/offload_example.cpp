@@ -0,0 +1,118 @@
+#include "buffio/group.hpp"
+#include "buffio/offload.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+/*
+ * - a long job and short jobs queued behind it on the same worker, the
+ *   short ones are stolen by the idle workers instead of waiting.
+ * - the loop keeps running a ticker routine while the jobs run.
+ * - results, void functions and exceptions come back to the routine.
+ */
+
+#define COMPUTE_WORKERS 3
+#define SHORT_JOBS 8
+
+static long elapsedUs(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+};
+
+static uint64_t checksum(size_t rounds) {
+  uint64_t hash = 1469598103934665603ULL;
+  for (size_t i = 0; i < rounds; i++)
+    hash = (hash ^ (i & 0xff)) * 1099511628211ULL;
+  return hash;
+};
+
+struct progress {
+  int running = 0;
+  int ticks = 0;
+};
+
+buffio::promise ticker(progress *state) {
+  while (state->running != 0) {
+    buffiowait buffio::clockSpec::wait{10};
+    state->ticks += 1;
+  };
+  buffioreturn 0;
+};
+
+buffio::promise longJob(progress *state) {
+  auto begin = std::chrono::steady_clock::now();
+  uint64_t hash =
+      buffiowait buffio::offload([] { return checksum(300000000); });
+  std::cout << "long job " << std::hex << hash << std::dec << " done in "
+            << elapsedUs(begin) / 1000 << "ms" << std::endl;
+  state->running -= 1;
+  buffioreturn 0;
+};
+
+buffio::promise shortJob(progress *state, long *slowest) {
+  auto begin = std::chrono::steady_clock::now();
+  auto loopThread = std::this_thread::get_id();
+  bool offLoop = buffiowait buffio::offload([loopThread] {
+    checksum(1000000);
+    return std::this_thread::get_id() != loopThread;
+  });
+  long took = elapsedUs(begin);
+  if (took > *slowest)
+    *slowest = took;
+  if (!offLoop)
+    std::cout << "short job ran on the loop" << std::endl;
+  state->running -= 1;
+  buffioreturn 0;
+};
+
+buffio::promise mixed(buffio::scheduler *loop) {
+  progress state;
+  long slowest = 0;
+  state.running = 1 + SHORT_JOBS;
+  buffio::taskGroup group;
+  group.spawn(ticker(&state));
+  // the long job takes the first worker, every third short job is pushed
+  // to the deque of that worker behind it.
+  group.spawn(longJob(&state));
+  for (int i = 0; i < SHORT_JOBS; i++)
+    group.spawn(shortJob(&state, &slowest));
+  buffiowait group.all();
+
+  auto stats = loop->offloadStats();
+  std::cout << SHORT_JOBS << " short jobs, slowest in " << slowest / 1000
+            << "ms, " << stats.stolen << " jobs stolen, loop ticks meanwhile "
+            << state.ticks << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise results() {
+  int counter = 0;
+  buffiowait buffio::offload([&counter] { counter = 42; });
+  std::cout << "void job set the counter to " << counter << std::endl;
+
+  try {
+    buffiowait buffio::offload([]() -> int {
+      throw std::runtime_error("bad input");
+    });
+  } catch (std::exception &e) {
+    std::cout << "job threw: " << e.what() << std::endl;
+  };
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop(2);
+  if (loop.error() || loop.computeWorkers(COMPUTE_WORKERS) != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+  loop.push(mixed(&loop));
+  loop.push(results());
+  loop.run();
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,55 @@
+#include "buffio/fiber.hpp"
+#include "buffio/group.hpp"
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+
+/*
+ * bursts of tiny requests on the sockBroker workers: each burst wakes the
+ * parked workers with one futex call, and workers still spinning from the
+ * previous burst take requests without any.
+ */
+
+#define BURSTS 200
+#define PER_BURST 32
+
+buffio::promise hop(size_t *done) {
+  buffio::fiber::clamper clamp;
+  buffiowait clamp.sclamp();
+  buffiowait clamp.unclamp();
+  *done += 1;
+  buffioreturn 0;
+};
+
+buffio::promise bursts(buffio::scheduler *loop) {
+  size_t done = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (int b = 0; b < BURSTS; b++) {
+    buffio::taskGroup group;
+    for (int i = 0; i < PER_BURST; i++)
+      group.spawn(hop(&done));
+    buffiowait group.all();
+  };
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count();
+
+  auto stats = loop->wakeStats();
+  std::cout << done << " hops in " << us << "us" << std::endl;
+  std::cout << "futex wakes " << stats.wakeCalls << ", workers woken "
+            << stats.woken << ", spin hits " << stats.spinHits
+            << ", wakeups avoided " << stats.avoided << std::endl;
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop(4, 8);
+  if (loop.error()) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+  loop.push(bursts(&loop));
+  loop.run();
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,61 @@
+#include "buffio/offload.hpp"
+#include "buffio/scheduler.hpp"
+#include "buffio/thread.hpp"
+#include "buffio/topology.hpp"
+#include <iostream>
+#include <sched.h>
+
+/*
+ * - the numa layout buffio sees.
+ * - a thread started pinned to a cpu.
+ * - a loop placed on node 0, its compute workers float on the cpus of
+ *   that node only.
+ */
+
+static int pinnedMain(void *data) {
+  auto cpu = (int *)data;
+  *cpu = ::sched_getcpu();
+  return 0;
+};
+
+buffio::promise workerPlacement() {
+  int node = buffiowait buffio::offload(
+      [] { return buffio::topology::affinityNode(); });
+  std::cout << "compute worker confined to node " << node << std::endl;
+  buffioreturn 0;
+};
+
+int main() {
+  long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+  std::cout << buffio::topology::nodes() << " numa node(s), " << cpus
+            << " cpu(s)" << std::endl;
+  for (long cpu = 0; cpu < cpus && cpu < 8; cpu++)
+    std::cout << "  cpu " << cpu << " on node "
+              << buffio::topology::nodeOf((int)cpu) << std::endl;
+
+  int lastCpu = (int)cpus - 1;
+  int ranOn = -1;
+  buffio::thread threads;
+  if (threads.run(nullptr, pinnedMain, &ranOn, buffio::thread::S1MB,
+                  {.cpu = lastCpu}) != 0) {
+    std::cout << "failed to start the pinned thread" << std::endl;
+    return 1;
+  };
+  threads.join();
+  threads.free();
+  std::cout << "thread pinned to cpu " << lastCpu << " ran on cpu " << ranOn
+            << std::endl;
+
+  buffio::scheduler loop;
+  loop.setNode(0);
+  if (loop.init(2) != 0 || loop.computeWorkers(2) != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+  std::cout << "loop placed on node " << loop.node() << ", confined to node "
+            << buffio::topology::affinityNode() << std::endl;
+  loop.push(workerPlacement());
+  loop.run();
+  loop.clean();
+  return 0;
+};
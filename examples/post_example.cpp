@@ -0,0 +1,65 @@
+#include "buffio/scheduler.hpp"
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/*
+ * producer threads post work into a loop that is already running, the loop
+ * is kept alive until every producer is done. the eventfd is only written
+ * by the first post after each drain of the inbox.
+ */
+
+#define PRODUCERS 4
+#define POSTS 50000
+
+static size_t callbacks = 0;
+static size_t routines = 0;
+
+void count(void *data) { *(size_t *)data += 1; };
+
+buffio::promise routine() {
+  routines += 1;
+  buffioreturn 0;
+};
+
+static void produce(buffio::scheduler *loop, int id) {
+  for (int i = 0; i < POSTS; i++) {
+    // the inbox is bounded, a full inbox means the loop is behind.
+    if (i % 10 == 0) {
+      // a routine that could not be posted is still ours, post it again.
+      buffio::promise task = routine();
+      while (loop->post(task) == (int)buffioErrorCode::postFull)
+        std::this_thread::yield();
+    } else {
+      while (loop->post(count, &callbacks) == (int)buffioErrorCode::postFull)
+        std::this_thread::yield();
+    };
+  };
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+  loop.keepAlive(true);
+
+  std::thread watcher([&loop]() {
+    std::vector<std::thread> producers;
+    for (int i = 0; i < PRODUCERS; i++)
+      producers.emplace_back(produce, &loop, i);
+    for (auto &producer : producers)
+      producer.join();
+    loop.keepAlive(false);
+  });
+
+  loop.run();
+  watcher.join();
+
+  std::cout << "posted " << PRODUCERS * POSTS << ", ran " << callbacks
+            << " callbacks and " << routines << " routines, "
+            << loop.postWakeups() << " eventfd writes" << std::endl;
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,44 @@
+#include "buffio/scheduler.hpp"
+#include <iostream>
+
+/*
+ * the same yielding routine pushed in every priority class, with the
+ * default weights the latency class finishes first and the background
+ * class last, even though background routines were pushed first.
+ */
+
+#define ROUNDS 20000
+#define ROUTINES 4
+
+static const char *names[BUFFIO_PRIORITY_NUM] = {"latency", "normal",
+                                                 "background"};
+static int finished = 0;
+
+buffio::promise worker(buffioPriority priority, int id) {
+  for (int i = 0; i < ROUNDS; i++) {
+    buffioyeild i;
+  };
+  std::cout << "[" << finished++ << "] " << names[(size_t)priority]
+            << " routine " << id << " done" << std::endl;
+  buffioreturn 0;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  for (int i = 0; i < ROUTINES; i++)
+    loop.push(worker(buffioPriority::background, i),
+              buffioPriority::background);
+  for (int i = 0; i < ROUTINES; i++)
+    loop.push(worker(buffioPriority::normal, i), buffioPriority::normal);
+  for (int i = 0; i < ROUTINES; i++)
+    loop.push(worker(buffioPriority::latency, i), buffioPriority::latency);
+
+  loop.run();
+  loop.clean();
+  return 0;
+};
@@ -0,0 +1,30 @@
+#include "buffio/shard.hpp"
+#include <iostream>
+
+buffio::promise hello(int shardId) {
+
+  for (int i = 0; i < 3; i++) {
+    buffio::clockSpec::wait delay;
+    delay.ms = 100;
+    __buffioCall(delay);
+    std::cout << "hello from shard - " << shardId << std::endl;
+  }
+  buffioreturn 0;
+};
+
+int setup(buffio::scheduler &loop, int shardId, void *data) {
+  loop.push(hello(shardId));
+  return 0;
+};
+
+int main() {
+
+  buffio::shards runtime;
+  if (runtime.start(4, setup, nullptr) != 0) {
+    std::cout << "failed to start shards" << std::endl;
+    return 1;
+  };
+  runtime.join();
+
+  return 0;
+};
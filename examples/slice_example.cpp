@@ -0,0 +1,77 @@
+#include "buffio/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+
+/*
+ * a cpu heavy routine that runs 2ms per resume shares the loop with light
+ * latency routines. with a 500us slice every resume of the hog is an
+ * overrun, in demote mode it sinks to the background class and, with the
+ * latency weight raised, the light routines finish way earlier.
+ */
+
+#define ROUNDS 20
+
+static void spin(long us) {
+  auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < until)
+    ;
+};
+
+static std::chrono::steady_clock::time_point begin;
+
+buffio::promise hog() {
+  for (int i = 0; i < 20; i++) {
+    spin(2000);
+    buffioyeild i;
+  };
+  auto self = buffio::fiber::queue->get();
+  std::cout << "  hog: " << self->resumes << " resumes, "
+            << self->runtime / 1000 << "us run, " << self->overruns
+            << " overruns" << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise light(int id) {
+  for (int i = 0; i < ROUNDS; i++) {
+    spin(2);
+    buffioyeild i;
+  };
+  if (id == 0) {
+    auto self = buffio::fiber::queue->get();
+    auto ms = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - begin)
+                  .count();
+    std::cout << "  light: " << self->resumes << " resumes, "
+              << self->runtime / 1000 << "us run, done after " << ms << "us"
+              << std::endl;
+  };
+  buffioreturn 0;
+};
+
+static void bench(buffioSliceAction action, const char *name) {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return;
+  };
+  loop.setSlice(500, action);
+  loop.setWeight(buffioPriority::latency, 64);
+
+  std::cout << "[" << name << "]" << std::endl;
+  loop.push(hog(), buffioPriority::latency);
+  for (int i = 0; i < 4; i++)
+    loop.push(light(i), buffioPriority::latency);
+
+  begin = std::chrono::steady_clock::now();
+  loop.run();
+  auto stats = loop.sliceStats();
+  std::cout << "  overruns " << stats.overruns << ", longest resume "
+            << stats.longest / 1000 << "us" << std::endl;
+  loop.clean();
+};
+
+int main() {
+  bench(buffioSliceAction::flag, "flag");
+  bench(buffioSliceAction::demote, "demote");
+  return 0;
+};
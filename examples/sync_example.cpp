@@ -0,0 +1,190 @@
+#include "buffio/group.hpp"
+#include "buffio/shard.hpp"
+#include "buffio/sync.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+/*
+ * - an uncontended lock/unlock pair, buffio::mutex against std::mutex.
+ * - routines queued on a held mutex get it in arrival order.
+ * - a pool of 2 connections shared by 8 routines through a semaphore.
+ * - a counter and a work queue shared by the routines of 4 shards, the
+ *   consumers wait on a condition notified from another shard.
+ */
+
+#define PAIRS 1000000
+#define SHARDS 4
+#define ROUTINES 8
+#define INCREMENTS 1000
+#define ITEMS 1000
+
+static long elapsedUs(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+};
+
+buffio::promise uncontended() {
+  buffio::mutex lock;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < PAIRS; i++) {
+    buffiowait lock.lock();
+    lock.unlock();
+  };
+  long buffioNs = elapsedUs(begin) * 1000 / (PAIRS / 1000);
+
+  std::mutex stdLock;
+  begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < PAIRS; i++) {
+    stdLock.lock();
+    stdLock.unlock();
+  };
+  long stdNs = elapsedUs(begin) * 1000 / (PAIRS / 1000);
+  std::cout << "uncontended pair: buffio::mutex " << buffioNs / 1000.0
+            << "ns, std::mutex " << stdNs / 1000.0 << "ns" << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise queued(buffio::mutex *lock, int id, std::string *order) {
+  buffiowait lock->lock();
+  *order += std::to_string(id) + " ";
+  lock->unlock();
+  buffioreturn 0;
+};
+
+buffio::promise fifo() {
+  buffio::mutex lock;
+  std::string order;
+  buffiowait lock.lock();
+  buffio::taskGroup group;
+  for (int i = 0; i < 5; i++)
+    group.spawn(queued(&lock, i, &order));
+  // let all of them park behind us.
+  buffiowait buffio::clockSpec::wait{10};
+  lock.unlock();
+  buffiowait group.all();
+  std::cout << "acquired in order: " << order << std::endl;
+  buffioreturn 0;
+};
+
+struct connectionPool {
+  buffio::semaphore free{2};
+  int inUse = 0;
+  int peak = 0;
+};
+
+buffio::promise query(connectionPool *pool) {
+  buffiowait pool->free.acquire();
+  pool->inUse += 1;
+  pool->peak = std::max(pool->peak, pool->inUse);
+  buffiowait buffio::clockSpec::wait{10};
+  pool->inUse -= 1;
+  pool->free.release();
+  buffioreturn 0;
+};
+
+buffio::promise pooled() {
+  connectionPool pool;
+  auto begin = std::chrono::steady_clock::now();
+  buffio::taskGroup group;
+  for (int i = 0; i < ROUTINES; i++)
+    group.spawn(query(&pool));
+  buffiowait group.all();
+  std::cout << ROUTINES << " queries of 10ms on 2 connections in "
+            << elapsedUs(begin) / 1000 << "ms, at most " << pool.peak
+            << " at once" << std::endl;
+  buffioreturn 0;
+};
+
+struct shared {
+  buffio::mutex lock;
+  buffio::condition ready;
+  size_t counter = 0;
+  std::deque<int> items;
+  bool closed = false;
+  std::atomic<size_t> consumed = 0;
+};
+
+buffio::promise incrementer(shared *state) {
+  for (int i = 0; i < INCREMENTS; i++) {
+    buffiowait state->lock.lock();
+    size_t value = state->counter;
+    // give the other routines (and shards) a chance to run meanwhile.
+    buffioyeild 0;
+    state->counter = value + 1;
+    state->lock.unlock();
+  };
+  buffioreturn 0;
+};
+
+buffio::promise producer(shared *state) {
+  for (int i = 0; i < ITEMS; i++) {
+    buffiowait state->lock.lock();
+    state->items.push_back(i);
+    state->lock.unlock();
+    state->ready.notifyOne();
+    if (i % 100 == 0)
+      buffiowait buffio::clockSpec::wait{1};
+  };
+  buffiowait state->lock.lock();
+  state->closed = true;
+  state->lock.unlock();
+  state->ready.notifyAll();
+  buffioreturn 0;
+};
+
+buffio::promise consumer(shared *state) {
+  buffiowait state->lock.lock();
+  for (;;) {
+    while (state->items.empty() && !state->closed)
+      buffiowait state->ready.wait(state->lock);
+    if (state->items.empty())
+      break;
+    state->items.pop_front();
+    state->consumed.fetch_add(1, std::memory_order_relaxed);
+  };
+  state->lock.unlock();
+  buffioreturn 0;
+};
+
+int setup(buffio::scheduler &loop, int shardId, void *data) {
+  auto state = (shared *)data;
+  for (int i = 0; i < ROUTINES; i++)
+    loop.push(incrementer(state));
+  if (shardId == 0)
+    loop.push(producer(state));
+  else
+    loop.push(consumer(state));
+  return 0;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+  loop.push(uncontended());
+  loop.push(fifo());
+  loop.push(pooled());
+  loop.run();
+  loop.clean();
+
+  shared state;
+  buffio::shards runtime;
+  auto begin = std::chrono::steady_clock::now();
+  if (runtime.start(SHARDS, setup, &state) != 0) {
+    std::cout << "failed to start shards" << std::endl;
+    return 1;
+  };
+  runtime.join();
+  std::cout << SHARDS << " shards: counter " << state.counter << " of "
+            << SHARDS * ROUTINES * INCREMENTS << ", consumed "
+            << state.consumed.load() << " of " << ITEMS << " items in "
+            << elapsedUs(begin) / 1000 << "ms" << std::endl;
+  return 0;
+};
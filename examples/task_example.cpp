@@ -0,0 +1,69 @@
+#include "buffio/scheduler.hpp"
+#include "buffio/task.hpp"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/*
+ * typed routines: a record read behind a timer wait comes back as a move
+ * only value, totals are summed through nested awaits, an exception
+ * thrown by a routine reaches the routine awaiting it and a task can be
+ * pushed to the loop like any routine.
+ */
+
+buffio::task<std::unique_ptr<std::string>> readRecord(int id) {
+  buffiowait buffio::clockSpec::wait{10};
+  buffioreturn std::make_unique<std::string>("record-" + std::to_string(id));
+};
+
+buffio::task<size_t> total(int count) {
+  size_t bytes = 0;
+  for (int i = 0; i < count; i++) {
+    auto record = buffiowait readRecord(i);
+    bytes += record->size();
+  };
+  buffioreturn bytes;
+};
+
+buffio::task<void> validate(size_t bytes) {
+  if (bytes < 32)
+    throw std::runtime_error("short input, " + std::to_string(bytes) +
+                             " bytes");
+  buffioreturn;
+};
+
+buffio::promise consumer() {
+  auto first = buffiowait readRecord(7);
+  std::cout << "read " << *first << std::endl;
+
+  size_t bytes = buffiowait total(3);
+  std::cout << "3 records, " << bytes << " bytes" << std::endl;
+
+  try {
+    buffiowait validate(bytes);
+    std::cout << "validated" << std::endl;
+  } catch (std::exception &e) {
+    std::cout << "validate threw: " << e.what() << std::endl;
+  };
+  buffioreturn 0;
+};
+
+buffio::task<int> detached() {
+  std::cout << "task pushed to the loop ran, result dropped" << std::endl;
+  buffioreturn 42;
+};
+
+int main() {
+  buffio::scheduler loop;
+  if (loop.init() != 0) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+
+  loop.push(consumer());
+  loop.push(detached());
+  loop.run();
+  loop.clean();
+  return 0;
+};
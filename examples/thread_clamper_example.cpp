@@ -1,19 +1,90 @@
 #include "buffio/fiber.hpp"
 #include "buffio/scheduler.hpp"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
 
+/*
+ * - a cpu heavy checksum runs on a worker between sclamp() and unclamp(),
+ *   a ticker routine keeps running on the loop meanwhile.
+ * - round trips loop -> worker -> loop of one clamper, the header is
+ *   reused by every hop.
+ */
 
-buffio::promise clampedSelf() {
-  std::cout << "hello World!" << std::endl;
-  std::cout << "hello World! 7" << std::endl;
-  std::cout << "hello World! 7" << std::endl;
+#define ROUNDS 10000
 
+static long elapsedUs(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+};
+
+static uint64_t checksum(size_t rounds) {
+  uint64_t hash = 1469598103934665603ULL;
+  for (size_t i = 0; i < rounds; i++)
+    hash = (hash ^ (i & 0xff)) * 1099511628211ULL;
+  return hash;
+};
+
+struct progress {
+  bool done = false;
+  int ticks = 0;
+};
+
+buffio::promise ticker(progress *state) {
+  while (!state->done) {
+    buffiowait buffio::clockSpec::wait{10};
+    state->ticks += 1;
+  };
+  buffioreturn 0;
+};
+
+buffio::promise heavy(progress *state) {
+  auto loopThread = std::this_thread::get_id();
+  buffio::fiber::clamper clamp;
+
+  buffiowait clamp.sclamp();
+  bool onWorker = std::this_thread::get_id() != loopThread;
+  auto begin = std::chrono::steady_clock::now();
+  uint64_t hash = checksum(200000000);
+  long took = elapsedUs(begin) / 1000;
+  buffiowait clamp.unclamp();
+
+  bool backOnLoop = std::this_thread::get_id() == loopThread;
+  state->done = true;
+  std::cout << "checksum " << std::hex << hash << std::dec << " in " << took
+            << "ms, on a worker: " << (onWorker ? "yes" : "no")
+            << ", back on the loop: " << (backOnLoop ? "yes" : "no")
+            << ", loop ticks meanwhile: " << state->ticks << std::endl;
+  buffioreturn 0;
+};
+
+buffio::promise roundTrips() {
+  buffio::fiber::clamper clamp;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < ROUNDS; i++) {
+    buffiowait clamp.sclamp();
+    buffiowait clamp.unclamp();
+  };
+  std::cout << ROUNDS << " round trips to a worker, "
+            << elapsedUs(begin) * 1000 / ROUNDS << "ns each" << std::endl;
   buffioreturn 0;
 };
 
 int main() {
 
   buffio::scheduler scheduler(2);
-  scheduler.push(clampedSelf());
+  if (scheduler.error()) {
+    std::cout << "failed to init the scheduler" << std::endl;
+    return 1;
+  };
+  progress state;
+  scheduler.push(ticker(&state));
+  scheduler.push(heavy(&state));
+  scheduler.run();
+
+  scheduler.push(roundTrips());
   scheduler.run();
   scheduler.clean();
   return 0;
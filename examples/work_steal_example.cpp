@@ -0,0 +1,81 @@
+#include "buffio/shard.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+/*
+ * skewed-load benchmark: every task is spawned on shard 0, the other
+ * shards start idle. run once with work-stealing off and once with it on.
+ *
+ * usage: ./buffio_work_steal_example [shards] [tasks] [rounds]
+ */
+
+struct benchConfig {
+  int shardNum;
+  int tasks;
+  int rounds;
+  std::atomic<long> done;
+};
+
+std::atomic<uint64_t> sink = 0;
+
+buffio::promise crunch(benchConfig *config) {
+  uint64_t acc = (uint64_t)config;
+  for (int r = 0; r < config->rounds; r++) {
+    for (int i = 0; i < 20000; i++)
+      acc = acc * 6364136223846793005ULL + 1442695040888963407ULL;
+    buffioyeild 0;
+  };
+  sink.fetch_add(acc, std::memory_order_relaxed);
+  config->done.fetch_add(1, std::memory_order_relaxed);
+  buffioreturn 0;
+};
+
+int setup(buffio::scheduler &loop, int shardId, void *data) {
+  auto *config = (benchConfig *)data;
+
+  if (shardId == 0) {
+    for (int i = 0; i < config->tasks; i++)
+      loop.spawn(crunch(config));
+  };
+  return 0;
+};
+
+void bench(benchConfig &config, bool steal) {
+  config.done.store(0);
+
+  buffio::shards runtime;
+  runtime.steal(steal, 15);
+
+  auto now = std::chrono::steady_clock::now();
+  if (runtime.start(config.shardNum, setup, &config, 1) != 0) {
+    std::cout << "failed to start shards" << std::endl;
+    return;
+  };
+  runtime.join();
+  auto end = std::chrono::steady_clock::now();
+  auto us =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - now).count();
+
+  std::cout << "[stealing " << (steal ? "on " : "off") << "] tasks "
+            << config.done.load() << " in " << us / 1000 << " ms, "
+            << (us > 0 ? config.done.load() * 1000000 / us : 0)
+            << " tasks/s, stolen per shard :";
+  for (int i = 0; i < config.shardNum; i++)
+    std::cout << " " << runtime.stolen(i);
+  std::cout << std::endl;
+};
+
+int main(int argc, char *argv[]) {
+
+  benchConfig config;
+  config.shardNum = argc > 1 ? std::atoi(argv[1]) : 4;
+  config.tasks = argc > 2 ? std::atoi(argv[2]) : 2000;
+  config.rounds = argc > 3 ? std::atoi(argv[3]) : 10;
+
+  bench(config, false);
+  bench(config, true);
+
+  return 0;
+};
@@ -3,8 +3,10 @@
 #include "buffio/container.hpp"
 #include "buffio/memory.hpp"
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <type_traits>
+#include <vector>
 /**
  * @file buffioQueue.hpp
  * @author Harsh Sharma
@@ -21,6 +23,26 @@
 
 enum class buffioQueueNoMem : int { no = 1 };
 
+/*
+ * switches between a routine and the routine it awaits done inline during
+ * one resume, past it the switch goes through the run queue. bounds the
+ * stack where the compiler doesn't turn the transfer into a tail call
+ * (unoptimised or sanitised builds).
+ */
+#define BUFFIO_INLINE_SWITCHES 256
+/*
+ * resumes in a row a routine that keeps yielding gets before it is rotated
+ * behind its peers, rotating a large class on every yield costs a cache
+ * miss per resume.
+ */
+#define BUFFIO_YIELD_BURST 16
+
+struct buffioHeader;
+namespace buffio {
+struct joinState;
+struct cancelState;
+};
+
 /**
  * @brief buffiomain queue structure defination.
  */
@@ -30,6 +52,18 @@ public:
   buffio::container task;        ///< task handle of the task
   blockQueue *waiter;            ///< waiter for the task.
   blockQueue *prev;              ///< previous member of the queue.
+  buffioPriority priority;       ///< run queue class of the task.
+  int64_t deadline;              ///< steady clock deadline in ns, 0 if none.
+  uint64_t runtime;              ///< time spent running, in ns.
+  uint32_t resumes;              ///< number of times the task was resumed.
+  uint32_t overruns;             ///< resumes that exceeded the time slice.
+  uint32_t joinSlot;             ///< index of the task in its group.
+  buffio::joinState *join;       ///< group the task belongs to, or nullptr.
+  buffio::cancelState *cancel;   ///< cancel source bound, or nullptr.
+  blockQueue *cancelNext;        ///< next task bound to the same source.
+  blockQueue *cancelPrev;        ///< previous task bound to the same source.
+  buffioHeader *blocked;         ///< header of the last request awaited.
+  uint64_t timer;                ///< armed timer sequence, 0 if none.
 };
 
 /**
@@ -198,4 +232,181 @@ private:
   memoryQueue memory;
 };
 
+/**
+ * @brief deadline outcome of the routines of one run queue, a routine
+ * awaited by another one is accounted through the routine awaiting it.
+ */
+struct deadlineMissStats {
+  size_t met = 0;    ///< routines done before their deadline.
+  size_t missed = 0; ///< routines done after their deadline.
+};
+
+/**
+ * @class runQueue
+ * @brief execution queue of the scheduler, one circular queue per
+ * buffioPriority class.
+ *
+ * @details
+ * - every class queue shares the same entry memory, so an entry can move
+ *   between classes and is always given back to the pool it came from.
+ * - push() routes an entry to the queue of its priority field.
+ * - select() picks the class the next get()/pop()/erase() work on, with
+ *   a weighted round: every class with work gets up to weight picks per
+ *   round, higher classes first, so background work is never starved.
+ * - under buffioSchedPolicy::edf routines with a deadline are kept in a
+ *   min-heap instead and always run before the classes, nearest deadline
+ *   first.
+ */
+class runQueue {
+public:
+  runQueue();
+  ~runQueue() = default;
+
+  /**
+   * @brief gives out a fresh entry of the normal class without waiter,
+   * deadline and run time.
+   */
+  blockQueue *getEntry();
+  int push(blockQueue *entry);
+  int pushHead(blockQueue *entry);
+
+  /*
+   * the methods below work on the class chosen by the last select().
+   */
+  blockQueue *get() const {
+    return active == BUFFIO_PRIORITY_NUM ? running : level[active].get();
+  }
+  void pop();
+  void erase();
+  /**
+   * @brief puts entry in the place of the routine at the head of the
+   * selected class, which leaves the queue without going back to the pool.
+   * used to switch between a routine and the routine it awaits without a
+   * trip through the tail of the queue.
+   */
+  void replace(blockQueue *entry);
+  /**
+   * @brief gives an entry that already left the queue back to the pool.
+   */
+  void release(blockQueue *entry);
+  /**
+   * @brief routine the last resume ended in, nullptr once it left the head
+   * (suspended, finished or requeued).
+   */
+  blockQueue *last() const { return resumed; }
+  /**
+   * @brief routine picked by the last select(), nullptr once its entry went
+   * back to the pool (it may be handed out to another routine since).
+   */
+  blockQueue *picked() const { return selected; }
+  /**
+   * @brief accounts an inline switch of the current resume.
+   * @return false once BUFFIO_INLINE_SWITCHES is used up.
+   */
+  bool inlineSwitch() { return ++switches <= BUFFIO_INLINE_SWITCHES; }
+  void mvNext() {
+    if (active != BUFFIO_PRIORITY_NUM)
+      level[active].mvNext();
+  }
+
+  /**
+   * @brief chooses the class to run next.
+   * @return false if every class is empty.
+   */
+  bool select() {
+    // the class picked last holds every routine (no deadline heap either),
+    // no round to play, the common case of a loop running one class.
+    if (active != BUFFIO_PRIORITY_NUM && count != 0 &&
+        level[active].gcount() == count) {
+      switches = 0;
+      resumed = selected = level[active].get();
+      return true;
+    };
+    return selectRound();
+  };
+  /**
+   * @brief true if the routine at the head after running (it yielded) can
+   * be resumed again right away, without a select(), it has burst left.
+   */
+  bool rerun(blockQueue *entry) {
+    if (active == BUFFIO_PRIORITY_NUM || queued(entry) ||
+        ++burst >= BUFFIO_YIELD_BURST)
+      return false;
+    switches = 0;
+    return true;
+  };
+  /**
+   * @brief moves a routine that is still at the head of its class after
+   * running (it yielded) behind its peers.
+   */
+  void yielded(blockQueue *entry) {
+    burst = 0;
+    if (active == BUFFIO_PRIORITY_NUM && running == entry) {
+      running = nullptr;
+      active = (size_t)buffioPriority::normal;
+      count -= 1;
+      push(entry);
+      return;
+    };
+    if (queued(entry))
+      return;
+    auto &which = level[(size_t)entry->priority];
+    if (!which.empty() && which.get() == entry)
+      which.mvNext();
+  };
+  /**
+   * @brief moves the routine one class down, a routine still queued at the
+   * head of the selected class is requeued there right away.
+   */
+  void demote(blockQueue *entry);
+  buffioPriority current() const { return (buffioPriority)active; }
+
+  /**
+   * @brief sets the number of picks the class gets per round, minimum 1.
+   */
+  void setWeight(buffioPriority which, size_t weight);
+
+  /**
+   * @brief switches the ordering policy, routines with a deadline queued
+   * under edf go back to their class when switching to priority.
+   */
+  void setPolicy(buffioSchedPolicy which);
+  buffioSchedPolicy getPolicy() const { return policy; }
+  const deadlineMissStats &missStats() const { return misses; }
+
+  /**
+   * @brief steady clock time in ns, the clock of blockQueue::deadline.
+   */
+  static int64_t now();
+
+  bool empty() const { return (count == 0); };
+  size_t gcount() const { return count; }
+  size_t gcount(buffioPriority which) const {
+    return level[(size_t)which].gcount();
+  };
+
+private:
+  buffio::Queue<blockQueue, buffio::container, buffioQueueNoMem>
+      level[BUFFIO_PRIORITY_NUM];
+  buffio::Memory<blockQueue> memory;
+  std::vector<blockQueue *> deadlines; // min-heap on blockQueue::deadline.
+  blockQueue *running; // routine picked from the heap, off it while it runs.
+  blockQueue *resumed; // routine at the head since the last select().
+  blockQueue *selected; // routine picked by the last select().
+  deadlineMissStats misses;
+  size_t weight[BUFFIO_PRIORITY_NUM];
+  size_t credit[BUFFIO_PRIORITY_NUM];
+  size_t count;
+  size_t switches; // inline switches since the last select().
+  size_t burst; // reruns in a row of the routine at the head.
+  size_t active; // BUFFIO_PRIORITY_NUM when the deadline heap is selected.
+  buffioSchedPolicy policy;
+
+  bool queued(blockQueue *entry) const {
+    return policy == buffioSchedPolicy::edf && entry->deadline != 0;
+  };
+  void account(blockQueue *entry);
+  bool selectRound();
+};
+
 }; // namespace buffio
@@ -33,7 +33,28 @@ public:
   static action::xeturn clampThread(buffioHeader *header);
 
   static action::xeturn propBack(buffioHeader *header);
-  
+  /*
+   * stands in for the action of a request aborted before it ran, the
+   * awaiting routine sees header->abortCode in opError.
+   */
+  static action::xeturn aborted(buffioHeader *header);
+
+  /*
+   * completion actions of the io_uring backend, the scheduler stores the
+   * cqe result in header->aux (and -errno in opError) before calling them.
+   */
+  static action::xeturn uringReadWrite(buffioHeader *header);
+  static action::xeturn uringAccept(buffioHeader *header);
+  static action::xeturn uringConnect(buffioHeader *header);
+  static action::xeturn uringPoll(buffioHeader *header);
+
+  static action::xeturn uringAsyncRead(buffioHeader *header);
+  static action::xeturn uringAsyncWrite(buffioHeader *header);
+
+  static action::xeturn uringAsyncAccept(buffioHeader *header);
+  static action::xeturn uringAsyncAcceptIpv4(buffioHeader *header);
+  static action::xeturn uringAsyncAcceptIpv6(buffioHeader *header);
+
 };
 
 }; // namespace buffio
@@ -0,0 +1,131 @@
+#ifndef __BUFFIO_CANCEL_HPP__
+#define __BUFFIO_CANCEL_HPP__
+
+#include "buffio/promise.hpp"
+
+/*
+ * cooperative cancellation: a routine binds the token of a source, the
+ * routines it awaits or spawns afterwards are bound to the same source.
+ * cancel() aborts the request each bound routine is suspended on, the
+ * routine resumes right away and sees buffioErrorCode::cancelled.
+ *
+ *   buffio::cancelSource source;
+ *   loop.push(reader(&fd, source.token()));
+ *   ...
+ *   source.cancel(); // from a routine or callback of the same loop
+ *
+ *   buffio::promise reader(buffio::Fd *fd, buffio::cancelToken token) {
+ *     buffiowait token;
+ *     buffiowait fd->waitRead(buffer, len);
+ *     if (fd->readError() == (int)buffioErrorCode::cancelled)
+ *       buffioreturn -1;
+ *     ...
+ *   };
+ */
+
+namespace buffio {
+
+/**
+ * @brief shared by a cancelSource and the routines bound to it.
+ *
+ * the bound routines are linked through their run queue entry
+ * (blockQueue::cancelNext/cancelPrev), an entry leaves the list when its
+ * routine is done. released by whoever drops the last reference, the
+ * source, its last bound routine or the last scope nested in it.
+ */
+struct cancelState {
+  blockQueue *bound;         ///< head of the bound routines.
+  buffio::scheduler *loop;   ///< loop of the bound routines.
+  size_t refs;               ///< the source and every bound routine.
+  bool cancelled;
+  cancelState *outer = nullptr; ///< scope this one is nested in, if any.
+  cancelState *inner = nullptr; ///< head of the scopes nested in this one.
+  cancelState *next = nullptr;  ///< next scope nested in the same outer.
+  cancelState *prev = nullptr;
+
+  /**
+   * @brief binds the entry, an entry bound to another source is moved.
+   */
+  static void bind(cancelState *state, blockQueue *entry);
+  /**
+   * @brief unbinds the entry, called when its routine is done.
+   */
+  static void unbind(blockQueue *entry);
+  /**
+   * @brief new scope cancelled along with outer (if any), with one
+   * reference for the caller.
+   * @return nullptr if it could not be allocated.
+   */
+  static cancelState *nest(cancelState *outer);
+  /**
+   * @brief cancels the scope and the scopes nested in it, once.
+   * @return number of suspended requests aborted.
+   */
+  static size_t cancel(cancelState *state);
+  /**
+   * @brief drops a reference, the last one frees the scope.
+   */
+  static void release(cancelState *state);
+};
+
+/**
+ * @brief awaitable handle of a cancelSource.
+ *
+ * awaiting it binds the awaiting routine and returns right away, a token
+ * without state (buffio::cancelToken{}) unbinds it.
+ */
+struct cancelToken {
+  cancelState *state = nullptr;
+  bool cancelled() const { return state != nullptr && state->cancelled; }
+};
+
+/**
+ * @class cancelSource
+ * @brief owner side of a cancellation scope.
+ *
+ * @details
+ * - every bound routine has to run on the loop that calls cancel(), from
+ *   another thread post() a callback calling it.
+ * - suspended on an fd request, the request is aborted: removed from the
+ *   fd or the request batch, cancelled on the io_uring backend, or taken
+ *   back before a worker picks it up. a request a worker already took,
+ *   or the kernel already completed, keeps its result and isn't counted.
+ * - suspended on clockSpec::wait, the timer is disarmed.
+ * - suspended on a routine or a group, nothing to abort, the awaited
+ *   routines are bound too and finish early, waking it.
+ * - a request started by a routine of a cancelled source is aborted as
+ *   soon as it is awaited, a timer is not armed at all.
+ */
+class cancelSource {
+public:
+  cancelSource();
+  ~cancelSource();
+  cancelSource(cancelSource const &) = delete;
+  cancelSource &operator=(cancelSource const &) = delete;
+
+  /**
+   * @brief false if the shared state could not be allocated, the token
+   * binds nothing then.
+   */
+  bool valid() const { return state != nullptr; }
+  cancelToken token() const { return {state}; }
+
+  /**
+   * @brief cancels the scope, once.
+   * @return number of suspended requests aborted.
+   */
+  size_t cancel();
+  bool cancelled() const { return state != nullptr && state->cancelled; }
+
+private:
+  cancelState *state;
+};
+
+/**
+ * @brief true if the running routine is bound to a cancelled source.
+ */
+bool cancelled();
+
+}; // namespace buffio
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef __BUFFIO_CHANNEL_HPP__
+#define __BUFFIO_CHANNEL_HPP__
+
+#include "buffio/lfqueue.hpp"
+#include "buffio/scheduler.hpp"
+#include "buffio/waitlist.hpp"
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <utility>
+
+/*
+ * bounded channels: a sender suspends while the channel is full, a
+ * receiver while it is empty, both are parked on intrusive wait lists and
+ * resumed in FIFO order by the operation that unblocks them.
+ *
+ *   buffio::channel<request> requests(64);
+ *   bool sent = buffiowait requests.send(std::move(req));
+ *   while (std::optional<request> req = buffiowait requests.recv())
+ *     ...
+ *
+ * buffio::channel is for the routines of one loop, buffio::threadChannel
+ * carries values from any thread to the routines of one loop.
+ */
+
+namespace buffio {
+
+template <typename T> class channel;
+template <typename T> class threadChannel;
+
+/**
+ * @brief awaited tag of channel::send(), carries the value.
+ */
+template <typename T> struct channelSend {
+  buffio::channel<T> *chan;
+  T value;
+};
+
+/**
+ * @brief awaited tag of channel::recv().
+ */
+template <typename T> struct channelRecv {
+  buffio::channel<T> *chan;
+};
+
+/**
+ * @class channel
+ * @brief bounded MPMC channel between the routines of one loop.
+ *
+ * @details
+ * - the ring is allocated once by the constructor, a capacity of 0 makes
+ *   every send wait for a receiver (rendezvous).
+ * - a value goes straight from a parked sender to a receiver, or from a
+ *   sender to a parked receiver, without passing through the ring.
+ * - close() resumes every parked routine, senders resume with false,
+ *   receivers with std::nullopt once the ring is drained.
+ * - not thread safe, see threadChannel.
+ */
+template <typename T> class channel {
+public:
+  explicit channel(size_t capacity)
+      : ring(capacity != 0 ? new std::optional<T>[capacity] : nullptr),
+        cap(capacity), first(0), count(0), shut(false) {};
+  channel(channel const &) = delete;
+  channel &operator=(channel const &) = delete;
+  ~channel() = default;
+
+  /**
+   * @brief awaited, resumes with false if the channel is (or gets) closed
+   * before the value is taken.
+   */
+  buffio::channelSend<T> send(T value) { return {this, std::move(value)}; };
+  /**
+   * @brief awaited, resumes with the next value, std::nullopt once the
+   * channel is closed and drained.
+   */
+  buffio::channelRecv<T> recv() { return {this}; };
+
+  /**
+   * @brief sends without suspending, the value is left untouched when it
+   * can't be taken.
+   */
+  bool trySend(T &value) {
+    if (shut)
+      return false;
+    if (!receivers.empty()) {
+      *(std::optional<T> *)receivers.head->slot = std::move(value);
+      receivers.wake(true);
+      return true;
+    };
+    if (count == cap)
+      return false;
+    ring[(first + count) % cap] = std::move(value);
+    count += 1;
+    return true;
+  };
+
+  std::optional<T> tryRecv() {
+    std::optional<T> value;
+    if (count != 0) {
+      value = std::move(ring[first]);
+      ring[first].reset();
+      first = (first + 1) % cap;
+      count -= 1;
+      // the slot freed goes to the first parked sender.
+      if (!senders.empty()) {
+        ring[(first + count) % cap] = std::move(*(T *)senders.head->slot);
+        count += 1;
+        senders.wake(true);
+      };
+    } else if (!senders.empty()) {
+      value = std::move(*(T *)senders.head->slot);
+      senders.wake(true);
+    };
+    return value;
+  };
+
+  void close() {
+    shut = true;
+    while (!senders.empty())
+      senders.wake(false);
+    while (!receivers.empty())
+      receivers.wake(false);
+  };
+
+  bool closed() const { return shut; }
+  size_t size() const { return count; }
+  size_t capacity() const { return cap; }
+
+private:
+  friend buffio::channelSendAwaiter<T>;
+  friend buffio::channelRecvAwaiter<T>;
+
+  std::unique_ptr<std::optional<T>[]> ring;
+  size_t cap;
+  size_t first;
+  size_t count;
+  bool shut;
+  buffio::waitList senders;
+  buffio::waitList receivers;
+};
+
+template <typename T> struct channelSendAwaiter {
+  bool await_ready() const noexcept { return ready; }
+  void await_suspend(std::coroutine_handle<> h) noexcept {
+    node.slot = &value;
+    node.done = false;
+    node.park(false);
+    chan->senders.push(&node);
+  };
+  bool await_resume() noexcept { return node.done; };
+  buffio::channel<T> *chan;
+  T value;
+  buffio::waitNode node;
+  bool ready;
+};
+
+template <typename T> struct channelRecvAwaiter {
+  bool await_ready() const noexcept { return ready; }
+  void await_suspend(std::coroutine_handle<> h) noexcept {
+    node.slot = &result;
+    node.done = false;
+    node.park(false);
+    chan->receivers.push(&node);
+  };
+  std::optional<T> await_resume() { return std::move(result); };
+  buffio::channel<T> *chan;
+  std::optional<T> result;
+  buffio::waitNode node;
+  bool ready;
+};
+
+template <typename T>
+buffio::channelSendAwaiter<T>
+promiseBase::await_transform(buffio::channelSend<T> &&op) {
+  buffio::channelSendAwaiter<T> awaiter{.chan = op.chan,
+                                        .value = std::move(op.value),
+                                        .node = {},
+                                        .ready = true};
+  if (op.chan->trySend(awaiter.value))
+    awaiter.node.done = true;
+  else if (!op.chan->closed())
+    awaiter.ready = false;
+  return awaiter;
+};
+
+template <typename T>
+buffio::channelRecvAwaiter<T>
+promiseBase::await_transform(buffio::channelRecv<T> op) {
+  buffio::channelRecvAwaiter<T> awaiter{
+      .chan = op.chan, .result = op.chan->tryRecv(), .node = {}, .ready = true};
+  awaiter.ready = awaiter.result.has_value() || op.chan->closed();
+  return awaiter;
+};
+
+/**
+ * @brief awaited tag of threadChannel::recv().
+ */
+template <typename T> struct threadChannelRecv {
+  buffio::threadChannel<T> *chan;
+};
+
+/**
+ * @class threadChannel
+ * @brief bounded channel from any thread to the routines of one loop.
+ *
+ * @details
+ * - values go through a lock-free lfqueue of 1 << order slots, send()
+ *   never blocks and fails with buffioErrorCode::channelFull instead.
+ * - the receivers park on the loop, the first send finding them parked
+ *   posts one wakeup into the loop (scheduler::post, so one eventfd write
+ *   at most), the loop then hands the queued values to the receivers.
+ * - a parked receiver counts as a pending request, the loop stays up
+ *   waiting for the senders like it does for the workers.
+ * - the channel must outlive the loop iteration following the last
+ *   send() or close().
+ */
+template <typename T> class threadChannel {
+public:
+  threadChannel() = default;
+  threadChannel(threadChannel const &) = delete;
+  threadChannel &operator=(threadChannel const &) = delete;
+  ~threadChannel() = default;
+
+  /**
+   * @brief binds the channel to the loop of its receivers.
+   * @return 0 on success, buffioErrorCode::channelQueue on allocation
+   * failure.
+   */
+  int init(buffio::scheduler &receiverLoop, size_t order = 10) {
+    if (items.lfstart(order) != 0)
+      return (int)buffioErrorCode::channelQueue;
+    loop = &receiverLoop;
+    return 0;
+  };
+
+  /**
+   * @brief thread safe, sends without blocking.
+   * @return 0 on success, buffioErrorCode::channelFull or
+   * buffioErrorCode::channelClosed otherwise, the value is dropped then.
+   */
+  int send(T value) {
+    if (shut.load(std::memory_order_acquire))
+      return (int)buffioErrorCode::channelClosed;
+    if (!items.enqueue(std::optional<T>(std::move(value))))
+      return (int)buffioErrorCode::channelFull;
+    // pairs with the fence of a parking receiver, else both can miss.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed))
+      notify();
+    return 0;
+  };
+
+  /**
+   * @brief thread safe, parked receivers resume with std::nullopt once
+   * the queued values are taken.
+   */
+  void close() {
+    shut.store(true, std::memory_order_release);
+    notify();
+  };
+
+  /**
+   * @brief awaited by a routine of the loop, resumes with the next value,
+   * std::nullopt once the channel is closed and drained.
+   */
+  buffio::threadChannelRecv<T> recv() { return {this}; };
+  std::optional<T> tryRecv() { return items.dequeue(std::nullopt); };
+  bool closed() const { return shut.load(std::memory_order_acquire); }
+
+private:
+  friend buffio::threadChannelAwaiter<T>;
+
+  void notify() {
+    if (signalled.exchange(true, std::memory_order_acq_rel))
+      return;
+    // inbox full, the next send retries.
+    if (loop->post(threadChannel::deliver, this) != 0)
+      signalled.store(false, std::memory_order_release);
+  };
+
+  /*
+   * runs on the loop, hands the queued values to the parked receivers.
+   */
+  static void deliver(void *data) {
+    auto chan = (threadChannel *)data;
+    chan->signalled.store(false, std::memory_order_seq_cst);
+
+    while (!chan->receivers.empty()) {
+      std::optional<T> value = chan->tryRecv();
+      if (!value.has_value() && !chan->closed())
+        break;
+      *(std::optional<T> *)chan->receivers.head->slot = std::move(value);
+      chan->receivers.wake(true);
+    };
+    if (chan->receivers.empty())
+      chan->waiting.store(false, std::memory_order_relaxed);
+  };
+
+  buffio::lfqueue<std::optional<T>> items;
+  buffio::waitList receivers;
+  buffio::scheduler *loop = nullptr;
+  std::atomic<bool> waiting = false;
+  std::atomic<bool> signalled = false;
+  std::atomic<bool> shut = false;
+};
+
+template <typename T> struct threadChannelAwaiter {
+  bool await_ready() const noexcept { return ready; }
+  bool await_suspend(std::coroutine_handle<> h) noexcept {
+    chan->waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // a value (or the close) that raced the flag, take it right away.
+    result = chan->tryRecv();
+    if (result.has_value() || chan->closed())
+      return false;
+    node.slot = &result;
+    node.done = false;
+    node.park();
+    chan->receivers.push(&node);
+    return true;
+  };
+  std::optional<T> await_resume() { return std::move(result); };
+  buffio::threadChannel<T> *chan;
+  std::optional<T> result;
+  buffio::waitNode node;
+  bool ready;
+};
+
+template <typename T>
+buffio::threadChannelAwaiter<T>
+promiseBase::await_transform(buffio::threadChannelRecv<T> op) {
+  buffio::threadChannelAwaiter<T> awaiter{
+      .chan = op.chan, .result = op.chan->tryRecv(), .node = {}, .ready = true};
+  awaiter.ready = awaiter.result.has_value() || op.chan->closed();
+  return awaiter;
+};
+
+}; // namespace buffio
+
+#endif
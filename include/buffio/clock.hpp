@@ -13,6 +13,7 @@ using chrClock = std::chrono::steady_clock;
 struct buffioTimerInfo {
   chrClock::time_point expires;
   blockQueue *task;
+  uint64_t seq; // blockQueue::timer of the task when armed.
 };
 
 namespace buffio {
@@ -21,6 +22,20 @@ namespace clockSpec {
 struct wait {
   uint32_t ms;
 };
+/*
+ * latency budget of the awaiting routine from now on, inherited by the
+ * routines it awaits, 0 clears it. only ordered under
+ * buffioSchedPolicy::edf but always accounted as met or missed.
+ */
+struct deadline {
+  uint32_t us;
+};
+/*
+ * deadline of a single Fd wait, see Fd::waitRead and friends.
+ */
+struct timeout {
+  uint32_t ms;
+};
 }; // namespace clockSpec
 struct buffioTimerCmp {
   bool operator()(const buffioTimerInfo &a, const buffioTimerInfo &b) const {
@@ -30,18 +45,68 @@ struct buffioTimerCmp {
 using buffioClockTree =
     std::priority_queue<buffioTimerInfo, std::vector<buffioTimerInfo>,
                         buffioTimerCmp>;
+typedef void (*buffioDeadlineFire)(buffioHeader *header, void *data);
+
+#define BUFFIO_WHEEL_ORDER 12 // 4096 slots of 1ms.
+
+/**
+ * @class Clock
+ * @brief timers of one scheduler.
+ *
+ * @details
+ * - routine timers (clockSpec::wait) live in a binary heap.
+ * - request deadlines (clockSpec::timeout) live in a hashed timer wheel
+ *   of 1ms slots, the header is linked into the slot of its expiry tick,
+ *   so arming and disarming is O(1) and costs no allocation however many
+ *   connections are waiting. a deadline farther than one turn of the
+ *   wheel stays in its slot and is skipped until its tick is reached.
+ */
 class Clock {
 public:
   Clock() = default;
   ~Clock() = default;
 
   int getNext();
-  bool empty() const { return clockTree.empty(); }
+  bool empty() const { return live == 0 && armed == 0; }
 
   void push(uint32_t delay, blockQueue *task);
-  void pushExpired(buffio::Queue<> &queue);
+  void pushExpired(buffio::runQueue &queue);
+  /**
+   * @brief disarms the timer the task waits on, its heap node is dropped
+   * once it reaches the top.
+   * @return false if the task has no armed timer.
+   */
+  bool cancel(blockQueue *task);
+
+  /**
+   * @brief arms the deadline of a pending request, ms from now.
+   */
+  void arm(buffioHeader *header, uint32_t ms);
+  /**
+   * @brief disarms the deadline of the request, if armed.
+   */
+  void disarm(buffioHeader *header);
+  /**
+   * @brief disarms the deadlines that passed and calls fire for each.
+   */
+  void expireDeadlines(buffioDeadlineFire fire, void *data);
 
 private:
+  static uint64_t tick();
+  int nextDeadline();
+
+  // a node is stale once the task's timer no longer matches its seq.
+  bool stale(const buffioTimerInfo &info) const {
+    return info.task->timer != info.seq;
+  };
+
   buffioClockTree clockTree;
+  uint64_t sequence = 0;
+  size_t live = 0; // armed timers, the tree also holds cancelled ones.
+
+  buffioHeader *wheel[1 << BUFFIO_WHEEL_ORDER] = {nullptr};
+  uint64_t wheelTick = 0; // last tick expired.
+  uint64_t wheelNext = 0; // no deadline expires before this tick.
+  size_t armed = 0;
 };
 }; // namespace buffio
@@ -17,6 +17,7 @@
 #define BUFFIO_FD_ACCEPT_READY (1 << 7)
 #define BUFFIO_FD_READ_REQUEST (1 << 8)
 #define BUFFIO_FD_WRITE_REQUEST (1 << 9)
+#define BUFFIO_FD_URING (1 << 10)
 
 #define BUFFIO_HEADER_NEWED -11111111
 #include <iostream>
@@ -30,11 +31,17 @@ namespace buffio {
 class Fd;
 class sockBroker;
 class scheduler;
+class uring;
+namespace fiber {
+struct loopState;
+};
 
 /*
  * Prototypes for promise object
  */
 class promise;
+class coro;
+class computePool;
 using promiseHandle = std::coroutine_handle<>;
 
 /*
@@ -85,6 +92,17 @@ typedef void (*buffioAction)(buffioHeader *);
 typedef struct buffioHeader {
 
   bool isFresh;
+  /*
+   * set once the loop hands the request to a worker, the worker owns the
+   * header from then on and it can't be aborted anymore.
+   */
+  bool onWorker;
+  /*
+   * error the request is aborted with (buffioErrorCode::cancelled or
+   * timeout) while it is still on its way, 0 if none, reset whenever the
+   * header is prepared.
+   */
+  int abortCode;
   int iFd;
   /*
    * fd, is the pointer to the fd class created by the user/requested from
@@ -145,6 +163,14 @@ typedef struct buffioHeader {
 
   struct buffioHeader *next;
   struct buffioHeader *prev;
+
+  /*
+   * deadline of the request in the timer wheel of buffio::Clock, timerTick
+   * is 0 when no deadline is armed.
+   */
+  uint64_t timerTick;
+  struct buffioHeader *timerNext;
+  struct buffioHeader *timerPrev;
 } buffioHeader;
 
 typedef struct buffioHeaderSync {
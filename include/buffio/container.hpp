@@ -23,6 +23,7 @@ class makeContainer {
 public:
   static void routine(buffio::promise &_promise, buffio::container &tmp);
   static void function(containerCallback callback, void *data,buffio::container &tmp);
+  static void stackful(buffio::coro *task, buffio::container &tmp);
 };
 
 }; // namespace buffio
@@ -1,21 +1,163 @@
 /*
  * header file to create coroutine using normal function calls,
  * these type or routine support auto routine switch.
+ *
+ * a buffio::coro runs a plain function on a stack of its own, the calls
+ * below look blocking but switch back to the loop until the operation is
+ * done, so existing blocking style code runs on the loop unchanged:
+ *
+ *   void session(void *data) {
+ *     auto fd = (buffio::Fd *)data;
+ *     buffio::coro::wait(fd->waitRead(buffer, sizeof(buffer)));
+ *     if (fd->readError() != 0)
+ *       return;
+ *     buffio::coro::sleep(10);
+ *     ...
+ *   };
+ *
+ *   loop.push(buffio::coro::make(session, &fd));
  */
-#pragma once;
+#pragma once
 
-namespace buffio{
+#include "buffio/common.hpp"
+#include <cstddef>
 
-typedef struct{
- char *stack;
- size_t stack_size;
-}coro_wrapper;
-class coro{
+#define BUFFIO_CORO_STACK (64 * 1024) // default usable stack of a fiber.
+#define BUFFIO_CORO_POOLED 256        // free default stacks kept per pool.
 
+namespace buffio {
 
+/*
+ * one stack mapping, the lowest page is the guard page, an overflow
+ * faults there instead of running into the neighbour mapping.
+ */
+typedef struct {
+  char *stack;
+  size_t stack_size; // bytes mapped, guard page included.
+} coro_wrapper;
+
+/**
+ * @brief counters of a coroStacks pool.
+ */
+struct coroStackStats {
+  size_t maps = 0;   ///< stacks mapped.
+  size_t reuses = 0; ///< stacks served from the pool.
+  size_t unmaps = 0; ///< stacks given back to the kernel.
+  size_t pooled = 0; ///< free stacks in the pool right now.
 };
-}; // namespace buffio
 
+/**
+ * @class coroStacks
+ * @brief pool of fiber stacks, owned by a scheduler.
+ *
+ * @details
+ * - stacks of BUFFIO_CORO_STACK bytes are kept on a freelist once their
+ *   fiber is done, up to BUFFIO_CORO_POOLED of them, the freelist node
+ *   lives in the free stack itself.
+ * - other sizes are mapped and unmapped every time.
+ * - not thread safe, a fiber only runs on the loop that created it.
+ */
+class coroStacks {
+public:
+  coroStacks() : freeList(nullptr) {};
+  ~coroStacks();
+  coroStacks(coroStacks const &) = delete;
+  coroStacks &operator=(coroStacks const &) = delete;
+
+  /**
+   * @brief maps (or reuses) a stack of at least size usable bytes.
+   * @return 0 on success, buffioErrorCode::coroStack otherwise.
+   */
+  int get(size_t size, coro_wrapper &stack);
+  void put(coro_wrapper &stack);
+  const coroStackStats &stats() const { return counters; }
+
+  static int map(size_t size, coro_wrapper &stack);
+  static void unmap(coro_wrapper &stack);
+
+private:
+  struct freeStack {
+    freeStack *next;
+    coro_wrapper stack;
+  };
+  freeStack *freeList;
+  coroStackStats counters;
+};
+
+/**
+ * @class coro
+ * @brief stackful routine, a plain function run on its own stack.
+ *
+ * @details
+ * - make() maps the stack and builds the coro at its top, so a fiber is
+ *   a single mapping, pushed to the loop like any routine with
+ *   scheduler::push().
+ * - the run queue resumes it by switching to its stack, wait(), sleep()
+ *   and yield() switch back to the loop, only callee saved registers are
+ *   exchanged, no syscall is involved.
+ * - wait() and sleep() park the run queue entry exactly like awaiting
+ *   the header (or the timer) from a buffio::promise, the cancel source
+ *   and deadline of the entry apply the same way.
+ * - a fiber stays on the loop that created it, it is never stolen.
+ * - a fiber left suspended when the scheduler is cleaned has its stack
+ *   released without its frames being unwound.
+ */
+class coro {
+public:
+  using entryRoutine = void (*)(void *data);
+
+  /**
+   * @brief builds a fiber on a stack from the pool of the scheduler
+   * bound to the calling thread.
+   * @return nullptr if no stack could be mapped.
+   */
+  static buffio::coro *make(entryRoutine entry, void *data,
+                            size_t stackSize = BUFFIO_CORO_STACK);
+
+  /**
+   * @brief blocks the fiber until the request of the header completes,
+   * the result is read from the Fd as for a routine.
+   */
+  static void wait(buffioHeader *header);
+  /**
+   * @brief blocks the fiber for ms milliseconds.
+   */
+  static void sleep(size_t ms);
+  /**
+   * @brief lets the other routines of the loop run.
+   */
+  static void yield();
+  /**
+   * @brief true when called from a fiber.
+   */
+  static bool inside();
 
+  bool done() const { return finished; }
 
+  /*
+   * container hooks, see makeContainer::stackful.
+   */
+  static void run(void *data);
+  static void destroy(void *data);
 
+private:
+  coro() = default;
+  [[noreturn]] static void start(buffio::coro *self);
+  void switchOut();
+  void release();
+
+  void *sp;     // saved stack pointer of the fiber.
+  void *loopSp; // saved stack pointer of the loop while the fiber runs.
+  entryRoutine entry;
+  void *data;
+  buffio::coroStacks *pool; // nullptr: unmapped when done.
+  coro_wrapper stack;
+  bool finished;
+#if defined(__SANITIZE_ADDRESS__)
+  void *fakeStack;
+  const void *loopBottom;
+  size_t loopSize;
+#endif
+};
+
+}; // namespace buffio
@@ -0,0 +1,154 @@
+#ifndef BUFFIO_STEAL_DEQUE
+#define BUFFIO_STEAL_DEQUE
+
+/*
+ * IMPLEMENTAION BASED ON:
+ *  - Chase, Lev "Dynamic Circular Work-Stealing Deque"
+ *  - Le, Pop, Cohen, Zappa Nardelli "Correct and Efficient Work-Stealing
+ *    for Weak Memory Models"
+ *
+ * fixed size variant, the ring is never grown, push() reports a full
+ * deque and the caller falls back to its local queue.
+ */
+
+#include "lfcore.hpp"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <sys/types.h>
+
+namespace buffio {
+
+/**
+ * @class stealDeque
+ * @brief single owner, multi thief work-stealing deque.
+ *
+ * @details
+ * - push()/pop() are only called by the owner thread and work on the
+ *   bottom of the deque, no lock and no cas except for the last entry.
+ * - steal() can be called by any thread and takes from the top.
+ *
+ * T must be trivially copyable and fit in a std::atomic, buffio uses it
+ * with coroutine frame addresses.
+ */
+template <typename T> class stealDeque {
+public:
+  stealDeque() : ring(nullptr), mask(0) {
+    top.store(0, std::memory_order_relaxed);
+    bottom.store(0, std::memory_order_relaxed);
+  };
+  stealDeque(stealDeque const &) = delete;
+  stealDeque &operator=(stealDeque const &) = delete;
+
+  ~stealDeque() {
+    if (ring != nullptr)
+      delete[] ring;
+    ring = nullptr;
+  };
+
+  /**
+   * @brief allocates the ring of 2^order entries.
+   * @return 0 on success, -1 on error.
+   */
+  int init(size_t order) {
+    if (ring != nullptr || order > buffioatomix_max_order)
+      return -1;
+    try {
+      ring = new std::atomic<T>[(size_t)1 << order];
+    } catch (std::exception &e) {
+      return -1;
+    };
+    mask = ((ssize_t)1 << order) - 1;
+    return 0;
+  };
+
+  /**
+   * @brief owner only, pushes at the bottom.
+   * @return false if the deque is full.
+   */
+  bool push(T item) {
+    ssize_t b = bottom.load(std::memory_order_relaxed);
+    ssize_t t = top.load(std::memory_order_acquire);
+    if (b - t > mask)
+      return false;
+
+    ring[b & mask].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+  };
+
+  /**
+   * @brief owner only, pops from the bottom (LIFO).
+   * @return the entry or onEmpty.
+   */
+  T pop(T onEmpty) {
+    ssize_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ssize_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return onEmpty;
+    };
+
+    T item = ring[b & mask].load(std::memory_order_relaxed);
+    if (t == b) {
+      // last entry, race against the thieves.
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+        item = onEmpty;
+      bottom.store(b + 1, std::memory_order_relaxed);
+    };
+    return item;
+  };
+
+  /**
+   * @brief any thread, steals from the top (FIFO).
+   * @return the entry or onEmpty if the deque is empty or the race is lost.
+   */
+  T steal(T onEmpty) {
+    ssize_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ssize_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+      return onEmpty;
+
+    T item = ring[t & mask].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+      return onEmpty;
+    return item;
+  };
+
+  size_t size() const {
+    ssize_t b = bottom.load(std::memory_order_acquire);
+    ssize_t t = top.load(std::memory_order_acquire);
+    return (b > t) ? (size_t)(b - t) : 0;
+  };
+  bool empty() const { return size() == 0; }
+
+private:
+  __attribute__((aligned(BUFFIO_CACHE_BYTES))) std::atomic<ssize_t> top;
+  __attribute__((aligned(BUFFIO_CACHE_BYTES))) std::atomic<ssize_t> bottom;
+  __attribute__((aligned(BUFFIO_CACHE_BYTES))) std::atomic<T> *ring;
+  ssize_t mask;
+};
+
+/*
+ * stealGroup: the deques of a set of sharded schedulers, owned by
+ * buffio::shards so a deque outlives the scheduler pushing to it.
+ *
+ * an idle member counts itself in idle and keeps stealing, the group is
+ * done once every member is idle at the same time.
+ */
+struct stealGroup {
+  buffio::stealDeque<void *> *deque = nullptr;
+  size_t num = 0;
+  std::atomic<size_t> idle = 0;
+  std::atomic<bool> done = false;
+};
+
+}; // namespace buffio
+#endif
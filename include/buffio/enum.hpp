@@ -58,6 +58,45 @@ enum class buffioThreadStatus : uint32_t {
   configOk = 86,
 };
 
+/*
+ * backend used by the scheduler for socket and pipe operations.
+ */
+enum class buffioBackend : int {
+  epoll = 0,
+  uring = 1,
+};
+
+/*
+ * priority class of a runnable routine, every class has its own run queue
+ * and its share of the loop iterations (see buffio::runQueue).
+ */
+#define BUFFIO_PRIORITY_NUM 3
+enum class buffioPriority : uint8_t {
+  latency = 0,
+  normal = 1,
+  background = 2,
+};
+
+/*
+ * how the run queue orders runnable routines, edf runs the routine with the
+ * nearest deadline first and the priority classes only when no routine
+ * with a deadline is runnable.
+ */
+enum class buffioSchedPolicy : uint8_t {
+  priority = 0,
+  edf = 1,
+};
+
+/*
+ * what the loop does with a routine that ran longer than the time slice
+ * in one resume, it is always counted, demote also moves it one priority
+ * class down.
+ */
+enum class buffioSliceAction : uint8_t {
+  flag = 0,
+  demote = 1,
+};
+
 enum class buffioAcceptType : int {
   local = 1,
   ipv4,
@@ -227,7 +266,24 @@ enum class buffioReadWriteType : uint8_t {
   X(makeUnique, -26, "failed to create a unique ptr")                          \
   X(protocol, -27, "error invalid protocol number")                            \
   X(protocolString, -28, "error open, no protocol string")                     \
-  X(threadRun, -29, "failed to run threads")
+  X(threadRun, -29, "failed to run threads")                                   \
+  X(affinity, -30, "failed to set cpu affinity of the thread")                 \
+  X(shardNum, -31, "shard number must be greater than 0")                      \
+  X(uringSetup, -32, "failed to setup io_uring instance")                      \
+  X(uringOp, -33, "io_uring opcode required by buffio not supported")          \
+  X(uringFull, -34, "io_uring submission queue is full")                      \
+  X(uringBuffer, -35, "failed to map the io_uring buffer arena")              \
+  X(postFull, -36, "scheduler post inbox is full, retry later")               \
+  X(postInbox, -37, "failed to allocate the scheduler post inbox")            \
+  X(groupState, -38, "failed to allocate the task group state")              \
+  X(cancelled, -39, "the operation was cancelled")                           \
+  X(timeout, -40, "the operation did not complete before its deadline")      \
+  X(channelQueue, -41, "failed to allocate the channel queue")               \
+  X(channelFull, -42, "channel is full, retry later")                        \
+  X(channelClosed, -43, "the channel is closed")                             \
+  X(coroStack, -44, "failed to map the stack of the fiber")                  \
+  X(clampHeaders, -45, "failed to allocate the thread clamp headers")        \
+  X(computePool, -46, "failed to allocate the compute pool")
 
 #define X(ERROR_ENUM, ERROR_CODE, MESSAGE) ERROR_ENUM = ERROR_CODE,
 enum class buffioErrorCode : int { BUFFIO_ERROR_LIST };
@@ -175,6 +175,10 @@ public:
     readHeader.isFresh = writeHeader.isFresh = true;
     reserveHeader.fd = this;
     reserveHeader.isFresh = false;
+    readHeader.abortCode = writeHeader.abortCode = 0;
+    reserveHeader.abortCode = 0;
+    readHeader.timerTick = writeHeader.timerTick = 0;
+    reserveHeader.timerTick = 0;
     rwmask = 0;
     localfd = {0};
   };
@@ -359,12 +363,31 @@ public:
                            "type accept request");
     };
 
+    if (buffio::fiber::ring != nullptr) {
+      if constexpr (std::is_same_v<T, asyncAccept_local>)
+        reserveHeader.action = buffio::action::uringAsyncAccept;
+      else if constexpr (std::is_same_v<T, asyncAccept_in>)
+        reserveHeader.action = buffio::action::uringAsyncAcceptIpv4;
+      else
+        reserveHeader.action = buffio::action::uringAsyncAcceptIpv6;
+
+      // the peer address is fetched by the completion action.
+      reserveHeader.data.socketaddr = nullptr;
+      reserveHeader.isFresh = true;
+      if (buffio::fiber::ring->accept(&reserveHeader) != 0) {
+        reserveHeader.isFresh = false;
+        return buffioRoutineStatus::none;
+      };
+      buffio::fiber::state->pendingReq.fetch_add(1, std::memory_order_acq_rel);
+      return buffioRoutineStatus::none;
+    };
+
     if (!(rwmask & BUFFIO_FD_ACCEPT_READY)) {
       this->poll(EPOLLIN); // trigger events until there is client availble
     };
 
     reserveHeader.isFresh = true;
-    buffio::fiber::pendingReq.fetch_add(1, std::memory_order_acq_rel);
+    buffio::fiber::state->pendingReq.fetch_add(1, std::memory_order_acq_rel);
 
     if (rwmask & BUFFIO_READ_READY)
       buffio::fiber::requestBatch->pushHead(&reserveHeader);
@@ -372,7 +395,7 @@ public:
     return buffioRoutineStatus::none;
   };
   inline void asyncAccpetDone() {
-    buffio::fiber::pendingReq.fetch_add(-1, std::memory_order_acq_rel);
+    buffio::fiber::state->pendingReq.fetch_add(-1, std::memory_order_acq_rel);
   }
   /**
    *@brief method to add fd to polling
@@ -419,6 +442,13 @@ public:
    *
    */
   buffioHeader *waitAccept(struct sockaddr *addr, socklen_t socklen);
+  /**
+   * @brief waitAccept with a deadline, the routine resumes with
+   * buffioErrorCode::timeout in the error of the read side if no
+   * connection came in time.
+   */
+  buffioHeader *waitAccept(struct sockaddr *addr, socklen_t socklen,
+                           buffio::clockSpec::timeout timeout);
   /**
    * @brief method to wait until a connection is established to the socket
    *
@@ -428,7 +458,20 @@ public:
    *
    */
   buffioHeader *waitConnect(struct sockaddr *addr, socklen_t socklen);
+  /**
+   * @brief waitConnect with a deadline, getConnectError() is
+   * buffioErrorCode::timeout if the connection was not established in time.
+   */
+  buffioHeader *waitConnect(struct sockaddr *addr, socklen_t socklen,
+                            buffio::clockSpec::timeout timeout);
   int getConnectError() const { return writeHeader.opError; }
+  /**
+   * @brief error of the last awaited read (write),
+   * buffioErrorCode::cancelled if it was aborted by a cancelSource,
+   * buffioErrorCode::timeout if its deadline passed.
+   */
+  int readError() const { return readHeader.opError; }
+  int writeError() const { return writeHeader.opError; }
   /**
    * @brief linux read call wrapper to read from the fd
    * @param[in] buffer pointer to the buffer to read
@@ -462,6 +505,15 @@ public:
    */
 
   buffioHeader *waitRead(char *buffer, size_t len);
+  /**
+   * @brief waitRead with a deadline, readError() is
+   * buffioErrorCode::timeout if there was nothing to read in time.
+   *
+   * the deadline is only armed if the request has to wait, it is disarmed
+   * when the request completes first, both in O(1).
+   */
+  buffioHeader *waitRead(char *buffer, size_t len,
+                         buffio::clockSpec::timeout timeout);
 
   /**
    * @brief method to wait until there data to write
@@ -473,6 +525,12 @@ public:
    */
 
   buffioHeader *waitWrite(char *buffer, size_t len);
+  /**
+   * @brief waitWrite with a deadline, writeError() is
+   * buffioErrorCode::timeout if the fd did not take the data in time.
+   */
+  buffioHeader *waitWrite(char *buffer, size_t len,
+                          buffio::clockSpec::timeout timeout);
   /*
    *
    * asyncRead/asyncWrite behaves same as the waitRead/waitWrite, the difference
@@ -590,6 +648,12 @@ protected:
    */
   char *address = nullptr;
 
+  /**
+   * @brief slot of the file in the io_uring registered file table, -1 if
+   * the file is not registered.
+   */
+  int fileSlot = -1;
+
   /**
    * @brief union to hold the respective fd based on family type
    */
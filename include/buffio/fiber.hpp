@@ -9,65 +9,112 @@
 #include "buffio/enum.hpp"
 #include "buffio/clock.hpp"
 #include "buffio/common.hpp"
+#include "buffio/coroutine.hpp"
+#include "buffio/framepool.hpp"
 #include "buffio/memory.hpp"
 #include "buffio/sockbroker.hpp"
+#include "buffio/uring.hpp"
 #include <atomic>
 
+#define BUFFIO_CLAMP_HEADERS 16 // clamp headers per page of the pool.
+
 namespace buffio {
 
 namespace fiber {
 
-extern buffio::Queue<buffioHeader, void *, buffioQueueNoMem> *requestBatch;
-extern buffio::Queue<buffioHeader, void *, buffioQueueNoMem> *threadRequestBatch;
-extern buffio::Queue<> *queue;
-extern buffio::Clock *timerClock;
-extern buffio::sockBroker *poller;
-
-extern std::atomic<size_t> workerCount;
-extern std::atomic<ssize_t> abort; // below 0 to abort,
-extern std::atomic<ssize_t> FdCount;
-extern std::atomic<ssize_t> pendingReq;
-extern std::atomic<ssize_t> sleepingThread;
+/*
+ * loopState: counters shared between one event loop and the sockBroker
+ * workers serving it, every scheduler owns one instance.
+ */
+struct loopState {
+  std::atomic<size_t> workerCount = 0;
+  std::atomic<ssize_t> abort = 0; // below 0 to abort,
+  std::atomic<ssize_t> pendingReq = 0;
+  std::atomic<ssize_t> queuedCompleted = 0;
+  std::atomic<bool> loopWakedUp = false;
+};
 
-extern std::atomic<ssize_t> queuedCompleted;
+/*
+ * fiber context is per-thread, every thread running a scheduler binds
+ * the pointers below to the instance it runs, so several event loops
+ * can live in one process (see buffio::shards).
+ *
+ * they are read on every resume: constinit drops the lazy init check of an
+ * extern thread_local, initial-exec the __tls_get_addr call of position
+ * independent code (the library is linked in, never dlopen()ed).
+ */
+#define BUFFIO_FIBER_TLS                                                       \
+  constinit thread_local __attribute__((tls_model("initial-exec")))
+extern BUFFIO_FIBER_TLS buffio::Queue<buffioHeader, void *, buffioQueueNoMem>
+    *requestBatch;
+extern BUFFIO_FIBER_TLS buffio::Queue<buffioHeader, void *, buffioQueueNoMem>
+    *threadRequestBatch;
+extern BUFFIO_FIBER_TLS buffio::runQueue *queue;
+extern BUFFIO_FIBER_TLS buffio::Clock *timerClock;
+extern BUFFIO_FIBER_TLS buffio::sockBroker *poller;
+extern BUFFIO_FIBER_TLS buffio::scheduler *loop;
+extern BUFFIO_FIBER_TLS buffio::uring *ring; // nullptr on epoll
+extern BUFFIO_FIBER_TLS loopState *state;
+extern BUFFIO_FIBER_TLS buffio::framePool *frames; // nullptr: on the heap
+extern BUFFIO_FIBER_TLS buffio::coroStacks *stacks; // nullptr: unpooled
+extern BUFFIO_FIBER_TLS buffio::Memory<buffioHeader> *headers; // of clamper
+extern BUFFIO_FIBER_TLS buffio::computePool *compute; // nullptr: inline
 
-extern std::atomic<bool> loopWakedUp;
+extern std::atomic<ssize_t> FdCount;
 
+/*
+ * awaited tag of clamper::sclamp() and clamper::unclamp(), toWorker tells
+ * the direction of the hop.
+ */
 typedef struct {
   buffioHeader *header;
+  bool toWorker;
 } clampInfo;
 
-typedef struct clampNs {
-  buffioHeader *header;
-  buffio::promiseHandle then;
-} clampNs;
-
+/**
+ * @class clamper
+ * @brief moves the rest of a routine to the sockBroker workers and back,
+ * for cpu heavy sections (compression, encoding...) that would stall the
+ * loop.
+ *
+ * @details
+ *   buffio::fiber::clamper clamp;
+ *   buffiowait clamp.sclamp();  // runs on a worker from here
+ *   compress(buffer);
+ *   buffiowait clamp.unclamp(); // back on the loop
+ *
+ * - the header carrying the routine comes from a pool of the scheduler
+ *   and is reused by every hop of the clamper, a hop allocates nothing.
+ * - sclamp() parks the run queue entry like a pending request, unclamp()
+ *   hands the header back through the completion queue of the workers,
+ *   the loop resumes the routine as for any threaded request.
+ * - between the two only plain code may run, nothing that awaits the loop
+ *   (io, timers, other routines), and the routine must unclamp before it
+ *   returns or the clamper goes away.
+ * - without a scheduler or a worker sclamp() doesn't suspend, the section
+ *   runs on the loop.
+ */
 class clamper {
 public:
-  clamper(auto then) {
-    if (info.header == nullptr)
-      return;
-    info.header->action = buffio::action::clampThread;
+  clamper()
+      : pool(buffio::fiber::headers),
+        header(pool != nullptr ? pool->pop() : nullptr) {
+    if (header != nullptr)
+      header->action = buffio::action::clampThread;
   };
-  clamper() {
-    if (info.header == nullptr)
-      return;
-    info.header->action = buffio::action::clampThread;
+  ~clamper() {
+    if (header != nullptr)
+      pool->push(header);
   };
-  clampInfo sclamp() const { return info; };
-  clampInfo sclamp(auto then) {
-    return info;
-  }
+  clamper(clamper const &) = delete;
+  clamper &operator=(clamper const &) = delete;
 
-  void clamp(auto then) {
-    buffio::fiber::threadRequestBatch->push(info.header);
-  }
-  void clamp() { 
-    buffio::fiber::threadRequestBatch->push(info.header);
-  }
+  clampInfo sclamp() const { return {header, true}; };
+  clampInfo unclamp() const { return {header, false}; };
 
 private:
-  clampInfo info = {new buffioHeader};
+  buffio::Memory<buffioHeader> *pool;
+  buffioHeader *header;
 };
 
 }; // namespace fiber
@@ -0,0 +1,90 @@
+#ifndef __BUFFIO_FRAME_POOL_HPP__
+#define __BUFFIO_FRAME_POOL_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * coroutine frames of buffio::promise are served by the pool of the
+ * scheduler bound to the allocating thread, one freelist per size class.
+ */
+
+#define BUFFIO_FRAME_MIN_ORDER 6 // smallest class, 64 bytes.
+#define BUFFIO_FRAME_CLASSES 7   // 64 bytes up to 4KiB.
+#define BUFFIO_FRAME_PAGE 32768  // bytes of every page carved in frames.
+
+namespace buffio {
+
+/**
+ * @brief allocation counters of a framePool.
+ *
+ * allocs[i] counts the frames served by the class of 64 << i bytes, so it
+ * is the frame size distribution of the loop.
+ */
+struct frameAllocStats {
+  size_t allocs[BUFFIO_FRAME_CLASSES] = {0};
+  size_t heap = 0;    ///< frames larger than the biggest class.
+  size_t pages = 0;   ///< pages allocated.
+  size_t remote = 0;  ///< frames given back by another thread, reclaimed.
+  size_t largest = 0; ///< largest frame asked for, in bytes.
+};
+
+/**
+ * @class framePool
+ * @brief size class allocator of coroutine frames, owned by a scheduler.
+ *
+ * @details
+ * - every frame starts with a small head naming its pool and class, so a
+ *   frame can be released from any thread.
+ * - a frame allocated and released on the thread of its pool goes
+ *   through a plain freelist, no atomic operation involved.
+ * - a frame released by another thread (a routine stolen by another
+ *   shard, resumed by a worker) is pushed on an atomic list of the class,
+ *   taken over in one exchange once the local freelist runs dry.
+ * - frames larger than 4KiB, and frames allocated by threads without a
+ *   scheduler (post() producers), come from the heap.
+ *
+ * frames must not outlive the scheduler, the pages are freed with it.
+ */
+class framePool {
+public:
+  framePool();
+  ~framePool();
+  framePool(framePool const &) = delete;
+  framePool &operator=(framePool const &) = delete;
+
+  /**
+   * @brief allocates a frame from the pool bound to the calling thread.
+   */
+  static void *allocate(size_t size);
+  /**
+   * @brief gives a frame back to the pool it came from.
+   */
+  static void release(void *frame);
+
+  const frameAllocStats &stats() const { return counters; }
+
+private:
+  // 16 bytes, keeps the frame at the default new alignment.
+  struct frameHead {
+    framePool *pool;
+    size_t sizeClass;
+  };
+  struct frameNode {
+    frameNode *next;
+  };
+
+  void *pop(size_t sizeClass);
+  void push(size_t sizeClass, frameNode *node);
+  int makePage(size_t sizeClass);
+
+  frameNode *freeList[BUFFIO_FRAME_CLASSES];
+  std::atomic<frameNode *> remote[BUFFIO_FRAME_CLASSES];
+  frameNode *pages;
+  frameAllocStats counters;
+};
+
+}; // namespace buffio
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef __BUFFIO_GENERATOR_HPP__
+#define __BUFFIO_GENERATOR_HPP__
+
+#include "buffio/promise.hpp"
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/*
+ * async generators: co_yield hands a reference to the value straight to
+ * the routine awaiting next(), nothing is buffered. producer and consumer
+ * take turns in the same run queue entry slot, so a value costs two
+ * switches and no allocation.
+ *
+ *   buffio::generator<record> records(buffio::Fd &fd) {
+ *     record rec;
+ *     while (buffiowait fd.waitRead(...) ...)
+ *       buffioyeild rec;
+ *   }
+ *
+ *   auto stream = records(fd);
+ *   while (record *rec = buffiowait stream.next())
+ *     handle(*rec);
+ *
+ * the yielded value is only valid until the consumer awaits next() again.
+ */
+
+namespace buffio {
+
+/**
+ * @brief awaited tag of generator::next().
+ */
+template <typename T> struct generatorNext {
+  buffio::generator<T> *stream;
+};
+
+/**
+ * @class generator
+ * @brief routine producing a stream of T to the routine awaiting it.
+ *
+ * @details
+ * - the producer only runs while a consumer awaits next(), it is started
+ *   by the first one and can await anything a routine can, it inherits
+ *   the priority, deadline and cancel source of the consumer.
+ * - an exception leaving the producer is rethrown by next().
+ * - move only, dropping the generator destroys the producer, wherever it
+ *   is suspended at a co_yield.
+ */
+template <typename T> class generator {
+  static_assert(!std::is_reference_v<T>,
+                "buffio::generator yields references already, use the type");
+
+public:
+  class promise_type : public buffio::promiseBase {
+    friend buffio::generator<T>;
+    friend buffio::generatorAwaiter<T>;
+    friend buffio::promiseBase;
+
+  public:
+    /*
+     * switches back to the consumer, the producer entry is kept aside
+     * until the next next().
+     */
+    struct yieldAwaiter {
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+        self->queued = false;
+        return buffio::promiseBase::handBack(false);
+      };
+      void await_resume() noexcept {};
+      promise_type *self;
+    };
+
+    generator get_return_object() {
+      return generator(std::coroutine_handle<promise_type>::from_promise(*this));
+    };
+
+    yieldAwaiter yield_value(T &value) {
+      current = std::addressof(value);
+      return {this};
+    };
+    // a temporary lives until the end of the co_yield expression, that is
+    // until the consumer awaits next() again.
+    yieldAwaiter yield_value(T &&value) {
+      current = std::addressof(value);
+      return {this};
+    };
+
+    void return_void() {
+      current = nullptr;
+      status = buffioRoutineStatus::done;
+    };
+
+    void unhandled_exception() {
+      current = nullptr;
+      error = std::current_exception();
+      status = buffioRoutineStatus::unhandledException;
+    };
+
+  private:
+    T *current = nullptr;
+    blockQueue *entry = nullptr; // run queue entry, nullptr before start.
+    bool queued = false; // running for a consumer, not parked at a yield.
+    std::exception_ptr error;
+  };
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  // stolen frames are rebuilt from their address as a plain routine.
+  static_assert(alignof(promise_type) ==
+                alignof(buffio::promise::promise_type));
+
+  explicit generator(handle_type _handle) : handle(_handle) {};
+  generator(generator &&other) noexcept
+      : handle(std::exchange(other.handle, nullptr)) {};
+  generator &operator=(generator &&other) noexcept {
+    if (this != &other) {
+      drop();
+      handle = std::exchange(other.handle, nullptr);
+    };
+    return *this;
+  };
+  generator(generator const &) = delete;
+  generator &operator=(generator const &) = delete;
+  ~generator() { drop(); };
+
+  /**
+   * @brief awaited by the consumer, resumes with a pointer to the next
+   * value, or nullptr once the producer returned.
+   */
+  buffio::generatorNext<T> next() { return {this}; };
+  bool done() const { return !handle || handle.done(); };
+
+private:
+  friend buffio::promiseBase;
+  friend buffio::generatorAwaiter<T>;
+
+  void drop() {
+    if (!handle)
+      return;
+    auto &producer = handle.promise();
+    // the consumer is destroyed while it awaits next(), by the scheduler
+    // cleaning its queue, which destroys the producer and frees its entry.
+    if (!handle.done() && producer.queued) {
+      handle = nullptr;
+      return;
+    };
+    // parked at a co_yield, its entry is not queued anywhere.
+    if (!handle.done() && producer.entry != nullptr)
+      buffio::fiber::queue->release(producer.entry);
+    handle.destroy();
+    handle = nullptr;
+  };
+
+  handle_type handle;
+};
+
+/**
+ * @brief awaiter of generator::next().
+ */
+template <typename T> struct generatorAwaiter {
+  bool await_ready() const noexcept { return ready; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+    return next;
+  };
+  T *await_resume() {
+    if (stream == nullptr || !stream->handle)
+      return nullptr;
+    auto &producer = stream->handle.promise();
+    if (stream->handle.done()) {
+      // the final suspend gave the entry back already.
+      producer.entry = nullptr;
+      if (producer.error)
+        std::rethrow_exception(std::exchange(producer.error, nullptr));
+      return nullptr;
+    };
+    return producer.current;
+  };
+  buffio::generator<T> *stream;
+  std::coroutine_handle<> next;
+  bool ready;
+};
+
+template <typename T>
+buffio::generatorAwaiter<T>
+promiseBase::await_transform(buffio::generatorNext<T> request) {
+  auto stream = request.stream;
+  if (stream->done())
+    return {.stream = stream, .next = nullptr, .ready = true};
+
+  auto routine = stream->handle;
+  auto &producer = routine.promise();
+
+  // first value, the producer gets its entry like an awaited routine.
+  if (producer.entry == nullptr) {
+    auto next = call(buffio::promise(routine, &producer));
+    producer.entry = buffio::fiber::queue->get();
+    producer.queued = true;
+    return {.stream = stream, .next = next, .ready = false};
+  };
+
+  auto queue = buffio::fiber::queue;
+  auto entry = producer.entry;
+  entry->waiter = queue->get();
+  entry->priority = entry->waiter->priority;
+  entry->deadline = entry->waiter->deadline;
+  queue->replace(entry);
+  producer.queued = true;
+  if (!queue->inlineSwitch())
+    return {.stream = stream, .next = std::noop_coroutine(), .ready = false};
+  return {.stream = stream, .next = routine, .ready = false};
+};
+
+}; // namespace buffio
+
+#endif
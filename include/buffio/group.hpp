@@ -0,0 +1,157 @@
+#ifndef __BUFFIO_GROUP_HPP__
+#define __BUFFIO_GROUP_HPP__
+
+#include "buffio/promise.hpp"
+#include <sys/types.h>
+
+/*
+ * structured fan-out: a routine spawns children into a group and awaits
+ * all of them (or the first one), they run concurrently on the loop of the
+ * routine and the routine is resumed exactly once, when the condition is
+ * met.
+ *
+ *   buffio::taskGroup group;
+ *   group.spawn(fetch(a));
+ *   group.spawn(fetch(b));
+ *   buffiowait group.all();
+ *
+ *   ssize_t first = buffiowait buffio::whenAny(fetch(a), fetch(b));
+ *
+ * whenAll and whenAny resume with the error of a routine that could not
+ * be spawned, once the ones spawned are done (the first one, for whenAny).
+ */
+
+namespace buffio {
+
+/**
+ * @brief join point shared by a group and its children.
+ *
+ * allocated once per group, the children link to it through their run
+ * queue entry (blockQueue::join), so there is no allocation per child
+ * beyond its coroutine frame. released by whoever drops the last
+ * reference, the group or its last running child.
+ */
+struct joinState {
+  blockQueue *parent; ///< suspended awaiting routine, nullptr if none.
+  size_t refs;        ///< the group and its children still running.
+  size_t spawned;
+  size_t done;
+  size_t need;   ///< children done the parent waits for.
+  ssize_t first; ///< slot of the first child done, -1 before.
+  cancelState *scope; ///< cancelled once a child is done, whenAny only.
+
+  /**
+   * @brief accounts a finished child, called by promise::run.
+   */
+  static void finish(joinState *state, uint32_t slot);
+  /**
+   * @brief drops a reference, the last one frees the state.
+   */
+  static void release(joinState *state);
+};
+
+/**
+ * @brief awaited tag of taskGroup::all()/any().
+ */
+struct joinWait {
+  joinState *state;
+  size_t need;
+};
+
+/**
+ * @brief awaiter of a join, resumes with the slot of the first child done.
+ */
+struct joinAwaiter {
+  bool await_ready() const noexcept { return ready; }
+  void await_suspend(std::coroutine_handle<> h) noexcept {};
+  ssize_t await_resume() noexcept {
+    if (error != 0)
+      return error;
+    return state != nullptr ? state->first : -1;
+  };
+  joinState *state;
+  bool ready;
+  int error = 0; ///< spawn error of a whenAll/whenAny, 0 if none.
+};
+
+/**
+ * @class taskGroup
+ * @brief scope of child routines awaited together.
+ *
+ * @details
+ * - spawn() must be called from the routine that awaits the group, the
+ *   children inherit its priority and deadline and run on its loop.
+ * - a group going out of scope with children still running detaches
+ *   them, they run to completion and nobody is resumed.
+ */
+class taskGroup {
+public:
+  taskGroup() : state(nullptr), failed(0) {};
+  ~taskGroup();
+  taskGroup(taskGroup const &) = delete;
+  taskGroup &operator=(taskGroup const &) = delete;
+
+  /**
+   * @brief queues a child routine, it starts on the next loop iteration.
+   * @return slot of the child (its index in spawn order), a value below 0
+   * on error, the routine is destroyed without being started then.
+   */
+  ssize_t spawn(buffio::promise task);
+
+  /**
+   * @brief awaitable, resumes once every child spawned so far is done.
+   */
+  joinWait all() const { return {state, spawned()}; }
+  /**
+   * @brief awaitable, resumes once one child is done, with its slot.
+   */
+  joinWait any() const { return {state, spawned() > 0 ? (size_t)1 : 0}; }
+
+  size_t spawned() const { return state != nullptr ? state->spawned : 0; }
+  size_t finished() const { return state != nullptr ? state->done : 0; }
+  ssize_t first() const { return state != nullptr ? state->first : -1; }
+  /**
+   * @brief error of the first spawn() that failed, 0 if none.
+   */
+  int error() const { return failed; }
+
+protected:
+  /**
+   * @brief makes the children spawned from now on cancelled as soon as one
+   * of them is done, they stay bound to the source of the caller as well.
+   */
+  int race();
+
+private:
+  int open();
+
+  joinState *state;
+  int failed;
+};
+
+/**
+ * @brief group awaited in place, every routine passed has to finish.
+ *
+ *   buffiowait buffio::whenAll(a(), b(), c());
+ */
+class whenAll : public taskGroup {
+public:
+  template <typename... T> whenAll(T... tasks) { (spawn(tasks), ...); };
+};
+
+/**
+ * @brief group awaited in place, resumes with the slot of the first
+ * routine done, the others are cancelled (see buffio::cancelSource) and
+ * finish early, detached.
+ */
+class whenAny : public taskGroup {
+public:
+  template <typename... T> whenAny(T... tasks) {
+    race();
+    (spawn(tasks), ...);
+  };
+};
+
+}; // namespace buffio
+
+#endif
@@ -8,6 +8,7 @@
  */
 
 #include "lfcore.hpp"
+#include <utility>
 
 namespace buffio {
 template <typename T> class lfqueue {
@@ -54,11 +55,11 @@ public:
 
   ~lfqueue() {
     if (data != nullptr)
-      delete data;
+      delete[] data;
     if (acqueue.data != nullptr)
-      delete acqueue.data;
+      delete[] acqueue.data;
     if (freequeue.data != nullptr)
-      delete freequeue.data;
+      delete[] freequeue.data;
     data = nullptr;
     acqueue.data = nullptr;
     freequeue.data = nullptr;
@@ -70,7 +71,7 @@ public:
     size_t idx = lfCore::lfdequeue(&freequeue, queueorder);
     if (idx == BUFFIO_EMPTY)
       return false;
-    data[idx] = data_;
+    data[idx] = std::move(data_);
     lfCore::lfenqueue(&acqueue, queueorder, idx);
     return true;
   };
@@ -82,7 +83,7 @@ public:
     size_t idx = lfCore::lfdequeue(&acqueue, queueorder);
     if (idx == BUFFIO_EMPTY)
       return onEmpty;
-    T tmp = data[idx];
+    T tmp = std::move(data[idx]);
     lfCore::lfenqueue(&freequeue, queueorder, idx);
     return tmp;
   }
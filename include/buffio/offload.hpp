@@ -0,0 +1,196 @@
+#ifndef __BUFFIO_OFFLOAD_HPP__
+#define __BUFFIO_OFFLOAD_HPP__
+
+#include "buffio/deque.hpp"
+#include "buffio/sync.hpp"
+#include "buffio/thread.hpp"
+#include <atomic>
+#include <exception>
+#include <semaphore.h>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+/*
+ * cpu bound work off the loop: the function runs on a compute worker, the
+ * routine awaiting it is parked meanwhile and resumed on its loop with the
+ * result, or the exception the function threw.
+ *
+ *   loop.computeWorkers(4);
+ *   ...
+ *   size_t packed = buffiowait buffio::offload([&] {
+ *     return compress(input, output);
+ *   });
+ *
+ * the compute workers are a pool of their own, a long job never delays the
+ * file operations and threaded requests served by the sockBroker workers.
+ */
+
+#define BUFFIO_COMPUTE_ORDER 8 // jobs queued per compute worker, 2^order.
+
+namespace buffio {
+
+/**
+ * @brief a job of the compute pool, lives in the awaiter kept in the frame
+ * of the routine, so offloading allocates nothing.
+ */
+struct offloadJob {
+  void (*invoke)(offloadJob *job);
+  buffio::waitNode wait;
+};
+
+/**
+ * @brief counters of a computePool, updated by the workers.
+ */
+struct computeStats {
+  size_t jobs = 0;   ///< jobs run.
+  size_t stolen = 0; ///< jobs taken from the deque of a peer.
+};
+
+/**
+ * @class computePool
+ * @brief workers running offloaded functions, owned by a scheduler.
+ *
+ * @details
+ * - every worker has a stealDeque of its own, the loop pushes the jobs
+ *   round robin at the bottom, the worker takes them from the top and,
+ *   once its deque is empty, steals from its peers.
+ * - a sleeping worker is woken for the job pushed to its deque, when it is
+ *   busy an idle peer is woken instead to steal it, so one long job only
+ *   holds its own worker.
+ * - submit() is only called by the thread of the owning loop.
+ */
+class computePool {
+public:
+  computePool()
+      : workers(nullptr), workerNum(0), next(0), stopping(false) {};
+  ~computePool() { stop(); };
+  computePool(computePool const &) = delete;
+  computePool &operator=(computePool const &) = delete;
+
+  /**
+   * @brief starts workerNum workers with deques of 2^order jobs, on the
+   * cpus of node, or anywhere for -1.
+   * @return 0 on success, value below 0 on error.
+   */
+  int start(int workerNum, size_t order = BUFFIO_COMPUTE_ORDER,
+            int node = -1);
+  /**
+   * @brief waits for the workers to exit, queued jobs are not run.
+   */
+  void stop();
+  bool running() const { return workerNum != 0; }
+  size_t num() const { return workerNum; }
+
+  /**
+   * @brief queues the job on a worker.
+   * @return false if every deque is full.
+   */
+  bool submit(offloadJob *job);
+  buffio::computeStats stats() const;
+
+private:
+  struct alignas(BUFFIO_CACHE_BYTES) worker {
+    buffio::stealDeque<offloadJob *> deque;
+    computePool *pool;
+    size_t id;
+    sem_t signal;
+    std::atomic<bool> sleeping;
+    std::atomic<size_t> jobs;
+    std::atomic<size_t> stolen;
+  };
+
+  static int workerMain(void *data);
+  offloadJob *take(worker *self);
+  bool pending() const;
+  void wake(worker *target);
+
+  worker *workers;
+  size_t workerNum;
+  size_t next; // worker of the next job, loop thread only.
+  std::atomic<bool> stopping;
+  buffio::thread threads;
+};
+
+/**
+ * @brief awaited tag of buffio::offload(), carries the function.
+ */
+template <typename F> struct offloadCall {
+  F fn;
+};
+
+/**
+ * @brief runs fn on the compute pool of the loop, awaited.
+ *
+ * without compute workers (see scheduler::computeWorkers) fn runs on the
+ * loop, in place.
+ */
+template <typename F> buffio::offloadCall<std::decay_t<F>> offload(F &&fn) {
+  return {std::forward<F>(fn)};
+};
+
+/**
+ * @brief awaiter of buffio::offload(), parks in await_suspend, where the
+ * job has its final address.
+ */
+template <typename F> struct offloadAwaiter : public buffio::offloadJob {
+  using resultType = std::invoke_result_t<F &>;
+  static_assert(!std::is_reference_v<resultType>,
+                "buffio::offload can't return a reference, return a pointer");
+  using slotType =
+      std::conditional_t<std::is_void_v<resultType>, std::monostate,
+                         resultType>;
+
+  explicit offloadAwaiter(F &&_fn) : fn(std::move(_fn)) {
+    invoke = offloadAwaiter::run;
+  };
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> h) noexcept {
+    auto pool = buffio::fiber::compute;
+    if (pool == nullptr || !pool->running()) {
+      run(this);
+      return false;
+    };
+    // parked first, the worker may be done before submit() returns.
+    wait.park();
+    if (!pool->submit(this)) {
+      run(this);
+      wait.resume();
+    };
+    return true;
+  };
+  resultType await_resume() {
+    if (result.index() == 2)
+      std::rethrow_exception(std::get<2>(result));
+    if constexpr (!std::is_void_v<resultType>)
+      return std::move(std::get<1>(result));
+  };
+
+  static void run(offloadJob *job) {
+    auto self = static_cast<offloadAwaiter *>(job);
+    try {
+      if constexpr (std::is_void_v<resultType>) {
+        self->fn();
+        self->result.template emplace<1>();
+      } else {
+        self->result.template emplace<1>(self->fn());
+      };
+    } catch (...) {
+      self->result.template emplace<2>(std::current_exception());
+    };
+  };
+
+  F fn;
+  std::variant<std::monostate, slotType, std::exception_ptr> result;
+};
+
+template <typename F>
+buffio::offloadAwaiter<F>
+promiseBase::await_transform(buffio::offloadCall<F> &&call) {
+  return buffio::offloadAwaiter<F>(std::move(call.fn));
+};
+
+}; // namespace buffio
+
+#endif
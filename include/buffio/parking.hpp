@@ -0,0 +1,77 @@
+#ifndef __BUFFIO_PARKING_HPP__
+#define __BUFFIO_PARKING_HPP__
+
+#include "buffio/lfcore.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+/*
+ * futex based parking lot of the sockBroker workers: an event count a
+ * worker parks on once its queue is empty, and the loop wakes any number
+ * of workers with a single syscall after publishing a batch of requests.
+ *
+ *   worker                          loop
+ *   ticket = lot.prepare();         queue.push(...);
+ *   if (!queue.empty())             if (lot.waiting() != 0)
+ *     lot.cancel();                   lot.wake(n);
+ *   else
+ *     lot.park(ticket);
+ *
+ * prepare() counts the worker as parked before it checks the queue again,
+ * so either it sees the request or the loop sees it waiting, and a wake
+ * between prepare() and park() makes park() return right away.
+ */
+
+namespace buffio {
+
+/**
+ * @brief wakeups of a worker pool.
+ */
+struct parkingStats {
+  size_t wakeCalls = 0; ///< futex wake syscalls.
+  size_t woken = 0;     ///< workers asked to wake by them.
+  size_t spinHits = 0;  ///< requests taken by a spinning worker.
+  size_t avoided = 0;   ///< wakeups saved against a post per request.
+};
+
+class parkingLot {
+public:
+  parkingLot() = default;
+  parkingLot(parkingLot const &) = delete;
+  parkingLot &operator=(parkingLot const &) = delete;
+
+  /**
+   * @brief counts the calling thread as parked, the condition it waits
+   * for must be checked again afterwards.
+   * @return ticket for park().
+   */
+  uint32_t prepare() {
+    parked.fetch_add(1, std::memory_order_seq_cst);
+    return epoch.load(std::memory_order_seq_cst);
+  };
+  /**
+   * @brief withdraws prepare(), the condition turned true meanwhile.
+   */
+  void cancel() { parked.fetch_add(-1, std::memory_order_relaxed); };
+  /**
+   * @brief sleeps until woken after prepare(), or until the deadline
+   * (CLOCK_MONOTONIC) if one is given.
+   * @return false on timeout.
+   */
+  bool park(uint32_t ticket, const struct timespec *deadline = nullptr);
+  /**
+   * @brief wakes up to n parked threads, one syscall whatever n is.
+   */
+  void wake(int n);
+  int waiting() const { return parked.load(std::memory_order_seq_cst); }
+
+private:
+  __attribute__((aligned(BUFFIO_CACHE_BYTES))) std::atomic<uint32_t> epoch = 0;
+  __attribute__((aligned(BUFFIO_CACHE_BYTES))) std::atomic<int> parked = 0;
+};
+
+}; // namespace buffio
+
+#endif
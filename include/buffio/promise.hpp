@@ -22,18 +22,157 @@ struct buffioAwaiter {
 };
 
 namespace buffio {
+
+/*
+ * awaiting a routine transfers to it right away, the loop is not involved.
+ * the child takes the place of its caller in the run queue, once done it
+ * hands the place back and resumes the caller directly, which then frees
+ * the child frame. next is a noop handle when the switch is left to the
+ * loop, see BUFFIO_INLINE_SWITCHES.
+ */
+struct callAwaiter {
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+    return next;
+  };
+  void await_resume() noexcept { child.destroy(); };
+  std::coroutine_handle<> child;
+  std::coroutine_handle<> next;
+};
+
+struct finalAwaiter {
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept;
+  void await_resume() noexcept {};
+};
+
+struct joinWait;
+struct joinAwaiter;
+struct cancelToken;
+class whenAll;
+class whenAny;
+class promise;
+template <typename T> class task;
+template <typename T> struct taskAwaiter;
+template <typename T> class generator;
+template <typename T> struct generatorNext;
+template <typename T> struct generatorAwaiter;
+template <typename T> struct channelSend;
+template <typename T> struct channelRecv;
+template <typename T> struct threadChannelRecv;
+template <typename T> struct channelSendAwaiter;
+template <typename T> struct channelRecvAwaiter;
+template <typename T> struct threadChannelAwaiter;
+class mutex;
+class semaphore;
+class condition;
+struct mutexLock;
+struct semaphoreAcquire;
+struct conditionWait;
+struct mutexAwaiter;
+struct semaphoreAwaiter;
+struct conditionAwaiter;
+template <typename F> struct offloadCall;
+template <typename F> struct offloadAwaiter;
+
+/*
+ * part of the promise type shared by every kind of routine, the run queue
+ * and buffio::promise only ever see a routine through it, so buffio::task
+ * frames run through the same container as plain routines.
+ */
+class promiseBase {
+  friend buffio::promise;
+
+protected:
+  buffioRoutineStatus status = buffioRoutineStatus::fresh;
+
+public:
+  std::suspend_always initial_suspend() noexcept {
+    status = buffioRoutineStatus::executing;
+    return {};
+  };
+
+  buffio::finalAwaiter final_suspend() noexcept { return {}; };
+
+  /*
+   * frames come from the frame pool of the scheduler bound to the
+   * thread, see buffio::framePool.
+   */
+  static void *operator new(std::size_t size) {
+    return buffio::framePool::allocate(size);
+  };
+  static void operator delete(void *frame, std::size_t size) noexcept {
+    buffio::framePool::release(frame);
+  };
+  std::suspend_always yield_value(int value) { return {}; };
+
+  buffio::callAwaiter await_transform(buffio::promise promise);
+  buffioAwaiter await_transform(buffioRoutineStatus ustatus) const;
+  buffioAwaiter await_transform(buffio::clockSpec::wait wait);
+  buffioAwaiter await_transform(buffio::clockSpec::deadline deadline);
+  buffioAwaiter await_transform(buffioHeader *header);
+  buffioAwaiter await_transform(fiber::clampInfo info);
+  joinAwaiter await_transform(buffio::joinWait wait);
+  joinAwaiter await_transform(buffio::whenAll &&group);
+  joinAwaiter await_transform(buffio::whenAny &&group);
+  buffioAwaiter await_transform(buffio::cancelToken token);
+  buffio::mutexAwaiter await_transform(buffio::mutexLock op);
+  buffio::semaphoreAwaiter await_transform(buffio::semaphoreAcquire op);
+  buffio::conditionAwaiter await_transform(buffio::conditionWait op);
+
+  /*
+   * awaits a typed routine, defined in buffio/task.hpp.
+   */
+  template <typename T>
+  buffio::taskAwaiter<T> await_transform(buffio::task<T> &&child);
+  /*
+   * awaits the next value of a generator, defined in buffio/generator.hpp.
+   */
+  template <typename T>
+  buffio::generatorAwaiter<T> await_transform(buffio::generatorNext<T> next);
+  /*
+   * channel operations, defined in buffio/channel.hpp.
+   */
+  template <typename T>
+  buffio::channelSendAwaiter<T> await_transform(buffio::channelSend<T> &&op);
+  template <typename T>
+  buffio::channelRecvAwaiter<T> await_transform(buffio::channelRecv<T> op);
+  template <typename T>
+  buffio::threadChannelAwaiter<T>
+  await_transform(buffio::threadChannelRecv<T> op);
+  /*
+   * runs a function on the compute pool, defined in buffio/offload.hpp.
+   */
+  template <typename F>
+  buffio::offloadAwaiter<F> await_transform(buffio::offloadCall<F> &&call);
+
+  /**
+   * @brief gives the place of the running routine back to the routine
+   * awaiting it (blockQueue::waiter).
+   *
+   * @param[in] finished the entry of the running routine goes back to the
+   * pool, otherwise it is kept aside to be resumed again.
+   * @return handle to transfer to, a noop handle when the switch is left
+   * to the loop.
+   */
+  static std::coroutine_handle<> handBack(bool finished);
+
+protected:
+  /**
+   * @brief queues the awaited routine in the place of the caller.
+   * @return handle to transfer to, a noop handle when the switch is left
+   * to the loop.
+   */
+  static std::coroutine_handle<> call(buffio::promise child);
+};
+
 class promise {
 public:
   class promise_type;
   using coro_handle = std::coroutine_handle<promise_type>;
   using void_handle = std::coroutine_handle<>;
 
-  class promise_type {
-    friend buffio::promise;
-
-  private:
-    buffioRoutineStatus status = buffioRoutineStatus::fresh;
- 
+  class promise_type : public buffio::promiseBase {
   public:
     using promiseObject = promise::promise_type;
     using buffioTypedHandle = std::coroutine_handle<promiseObject>;
@@ -51,20 +190,6 @@ public:
          return self;
     };
 
-    std::suspend_always initial_suspend() noexcept {
-      status = buffioRoutineStatus::executing;
-      return {};
-    };
-
-    std::suspend_always final_suspend() noexcept { return {}; };
-    std::suspend_always yield_value(int value) { return {}; };
-
-    buffioAwaiter await_transform(promise promise);
-    buffioAwaiter await_transform(buffioRoutineStatus ustatus) const;
-    buffioAwaiter await_transform(buffio::clockSpec::wait wait);
-    buffioAwaiter await_transform(buffioHeader *header);
-    buffioAwaiter await_transform(fiber::clampInfo info);
-
     void unhandled_exception() {
       status = buffioRoutineStatus::unhandledException;
     };
@@ -83,6 +208,14 @@ public:
                  .promise();
   }
 
+  /**
+   * @brief wraps a routine of any promise type derived from promiseBase.
+   */
+  promise(void_handle _handle, buffio::promiseBase *_paddr)
+      : handle(_handle), paddr(_paddr) {
+    assert(_handle && _paddr != nullptr);
+  };
+
   void_handle get() const { return handle; };
   static void run(void *data);
   static void destroy(void *data);
@@ -92,7 +225,7 @@ public:
 
 private:
   void_handle handle;
-  promise::promise_type *paddr;
+  buffio::promiseBase *paddr;
 };
 
 using promiseObject = buffio::promise::promise_type::promiseObject;
@@ -1,7 +1,11 @@
 #pragma once
+#include "buffio/deque.hpp"
 #include "buffio/fd.hpp"
 #include "buffio/fiber.hpp"
+#include "buffio/offload.hpp"
+#include "buffio/topology.hpp"
 #include "buffio/promise.hpp"
+#include <atomic>
 #include <iostream>
 #include <unistd.h>
 
@@ -47,6 +51,50 @@
  */
 
 namespace buffio {
+
+/**
+ * @brief state and counters of the busy-poll mode of the scheduler.
+ *
+ * hits counts the spins that found an event, misses the ones that ran
+ * out of budget and parked in epoll_wait anyway. budget is the current
+ * spin length in us, it doubles on a hit and halves on a miss, once it
+ * drops to 0 the loop parks directly for an exponentially growing number
+ * of iterations before probing with a short spin again.
+ */
+struct busyPollStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  long budget = 0;
+  long max = 0;
+  int sockBusyPoll = 0;
+};
+
+/*
+ * time slice accounting, with a slice set (or timed on) every resume of a
+ * routine is timed with one clock read (the TSC where available) and
+ * charged to its blockQueue entry, a resume longer than limit is an
+ * overrun handled per action.
+ */
+struct timeSliceStats {
+  size_t overruns = 0;
+  uint64_t longest = 0; // longest single resume seen, in ns.
+  uint64_t limit = 0;   // slice in ns, 0 disables the overrun check.
+  buffioSliceAction action = buffioSliceAction::flag;
+  bool timed = false; // time the resumes without a slice too.
+};
+
+/*
+ * routine posted from another thread, built by the poster and given an
+ * entry of the run queue by the loop once drained from the inbox.
+ */
+struct postTask {
+  buffio::container task;
+  buffioPriority priority;
+};
+#define BUFFIO_POST_ORDER 10 // inbox of 1024 routines.
+#define BUFFIO_YIELD_PASS_NS 200000 // routines run 200us per loop pass.
+#define BUFFIO_YIELD_CHECK 32 // untimed resumes between two pass clock reads.
+
 class scheduler {
 public:
   /**
@@ -87,26 +135,277 @@ public:
    * run.
    *
    * @param[in] handle The handle to the routine.
+   * @param[in] priority run queue class of the routine, routines it awaits
+   * inherit it.
    *
    * @return returns the value returned by the queue push method. and a value
    * smaller than 0 must be treated as error.
    *
    */
-  int push(buffio::promise task){
+  int push(buffio::promise task,
+           buffioPriority priority = buffioPriority::normal) {
     auto entry = queue.getEntry();
     buffio::makeContainer::routine(task,entry->task);
+    entry->priority = priority;
     queue.push(entry);
     return 0;
   };
-  int push(buffio::containerCallback callback,void *data){
+  int push(buffio::containerCallback callback, void *data,
+           buffioPriority priority = buffioPriority::normal) {
     auto entry = queue.getEntry();
     buffio::makeContainer::function(callback,data,entry->task);
+    entry->priority = priority;
     queue.push(entry);
     return 0;
   }
+  /**
+   * @brief pushes a fiber built by buffio::coro::make() on this thread.
+   * @return buffioErrorCode::coroStack if task is nullptr (make() failed).
+   */
+  int push(buffio::coro *task,
+           buffioPriority priority = buffioPriority::normal) {
+    if (task == nullptr)
+      return (int)buffioErrorCode::coroStack;
+    auto entry = queue.getEntry();
+    buffio::makeContainer::stackful(task, entry->task);
+    entry->priority = priority;
+    queue.push(entry);
+    return 0;
+  };
+  /**
+   * @brief sets how many routines of the class run per scheduling round
+   * while every class has work, defaults are latency 8, normal 4 and
+   * background 1.
+   */
+  void setWeight(buffioPriority which, size_t weight) {
+    queue.setWeight(which, weight);
+  };
+  /**
+   * @brief sets the run queue policy, under buffioSchedPolicy::edf the
+   * routines that awaited a buffio::clockSpec::deadline run nearest
+   * deadline first, ahead of the priority classes.
+   */
+  void setPolicy(buffioSchedPolicy policy) { queue.setPolicy(policy); };
+  buffioSchedPolicy getPolicy() const { return queue.getPolicy(); }
+  /**
+   * @brief deadlines met and missed by the routines finished on this loop.
+   */
+  const buffio::deadlineMissStats &deadlineStats() const {
+    return queue.missStats();
+  };
+  /**
+   * @brief sets the time slice of one resume, 0 disables the check.
+   *
+   * @param[in] us slice in microseconds.
+   * @param[in] action flag only counts the overrun, demote also moves the
+   * routine one priority class down.
+   */
+  void setSlice(uint32_t us,
+                buffioSliceAction action = buffioSliceAction::flag) {
+    slice.limit = (uint64_t)us * 1000;
+    slice.action = action;
+  };
+  /**
+   * @brief keeps blockQueue::runtime and the longest resume up to date
+   * without a slice, off by default as it costs a clock read per resume.
+   */
+  void setSliceStats(bool timed) { slice.timed = timed; };
+  const buffio::timeSliceStats &sliceStats() const { return slice; }
+
+  /**
+   * @brief pushes a routine that has no fd affinity yet.
+   *
+   * when the scheduler is part of a steal group (see buffio::shards) the
+   * routine is put on the scheduler's steal deque, where idle peers can
+   * take it, otherwise it behaves like push().
+   *
+   * @param[in] task routine to execute.
+   * @return value smaller than 0 must be treated as error.
+   */
+  int spawn(buffio::promise task);
+  /**
+   * @brief offers a routine to the steal deque only.
+   * @return false if the scheduler is not part of a steal group or the
+   * deque is full, the caller keeps the ownership of the routine then.
+   */
+  bool offer(buffio::promise task);
+  /**
+   * @brief makes the scheduler a member of a steal group, called by
+   * buffio::shards before run().
+   *
+   * @param[in] stealers the deques of every member of the group.
+   * @param[in] self index of the deque owned by this scheduler.
+   */
+  void attach(buffio::stealGroup *stealers, size_t self);
+  size_t stolen() const { return stealCount; }
+
+  /**
+   * @brief thread safe push into a running (or initialised) loop.
+   *
+   * the routine goes through a lock-free inbox drained by the loop every
+   * iteration, only the first post after a drain writes the eventfd to
+   * wake a parked loop, the ones following it share that wakeup.
+   *
+   * @return 0 on success, buffioErrorCode::postFull when the inbox is
+   * full and buffioErrorCode::epollInstance before init(), on error the
+   * routine stays with the caller and can be posted again.
+   */
+  int post(buffio::promise task,
+           buffioPriority priority = buffioPriority::normal);
+  int post(buffio::containerCallback callback, void *data,
+           buffioPriority priority = buffioPriority::normal);
+  /**
+   * @brief keeps run() parked instead of returning once there is no work
+   * left, so routines can still be posted. thread safe, switching it off
+   * wakes the loop to let it return.
+   */
+  void keepAlive(bool on);
+  /**
+   * @brief number of eventfd writes done by post() so far.
+   */
+  size_t postWakeups() const {
+    return postWakes.load(std::memory_order_relaxed);
+  };
+
+  /**
+   * @brief aborts the request or timer the routine of the entry is
+   * suspended on, see buffio::cancelSource.
+   * @return false if there was nothing to abort.
+   */
+  bool abortWait(blockQueue *entry);
+
+  /**
+   * @brief suspends the running routine on header until its request
+   * completes, aborted straight away if the routine is already cancelled.
+   * @return false if there is no header to wait on.
+   */
+  bool parkOn(buffioHeader *header);
+
+  /**
+   * @brief suspends the running routine for ms milliseconds.
+   * @return false if the routine is already cancelled.
+   */
+  bool parkFor(size_t ms);
 
   void clean(int tries = 5, int timeout = 100);
   bool error() const { return (workerlNum < 0); }
+  int workers() const { return workerlNum; }
+
+  /**
+   * @brief places the loop and its workers on a numa node, called before
+   * init().
+   *
+   * init() pins the calling thread to the cpus of node and prefers its
+   * memory, so the queues allocated by init() and the worker stacks are
+   * local to the loop. -1 (the default) follows the affinity of the
+   * thread calling init(): a loop confined to one node (see
+   * buffio::shards) gets its workers there, otherwise they float.
+   */
+  void setNode(int node) { homeNode = node; }
+  int node() const { return homeNode; }
+
+  /**
+   * @brief binds the fiber context of the calling thread to this instance.
+   *
+   * init() and run() bind the calling thread on their own, bind() is only
+   * needed when a thread wants to use Fd or promise operation of this
+   * instance before calling any of them.
+   */
+  void bind();
+
+  /**
+   * @brief selects the io backend, must be called before init().
+   *
+   * with buffioBackend::uring socket and pipe operations are submitted to
+   * an io_uring instance in one batch per loop iteration and completed
+   * straight into the run queue. init() falls back to epoll when the
+   * kernel has no usable io_uring, backend() reports the one in use.
+   */
+  void setBackend(buffioBackend type) { backendType = type; }
+  buffioBackend backend() const { return backendType; }
+
+  /**
+   * @brief sizes the registered buffer arena of the uring backend, must be
+   * called before init(), 0 blocks disables the arena.
+   */
+  void setBuffers(size_t blockSize, size_t blockNum) {
+    bufferSize = blockSize;
+    bufferNum = blockNum;
+  };
+  /**
+   * @brief takes a buffer of bufferSize bytes.
+   *
+   * on the uring backend the buffer comes from the registered arena and
+   * Fd reads and writes on it skip the per-operation page pinning of the
+   * kernel, otherwise (or with the arena exhausted) it is allocated.
+   * the buffer must be given back with putBuffer().
+   *
+   * @return nullptr on allocation failure.
+   */
+  char *getBuffer();
+  void putBuffer(char *buffer);
+  size_t getBufferSize() const { return bufferSize; }
+
+  /**
+   * @brief enables the busy-poll mode, 0 disables it.
+   *
+   * before parking in epoll_wait the loop polls without blocking for up
+   * to budgetUs microseconds, trading cpu for the wakeup latency.
+   *
+   * @param[in] budgetUs maximum spin length in microseconds.
+   * @param[in] sockBusyPollUs SO_BUSY_POLL value set on every socket
+   * mounted afterwards, 0 leaves the socket untouched.
+   */
+  void busyPoll(long budgetUs, int sockBusyPollUs = 0) {
+    busy.max = busy.budget = budgetUs > 0 ? budgetUs : 0;
+    busy.sockBusyPoll = sockBusyPollUs > 0 ? sockBusyPollUs : 0;
+  };
+  const buffio::busyPollStats &busyStats() const { return busy; }
+
+  /**
+   * @brief coroutine frame allocation counters of the routines created on
+   * the thread bound to this instance.
+   */
+  const buffio::frameAllocStats &frameStats() const { return frames.stats(); }
+  /**
+   * @brief stack mapping counters of the fibers created on the thread
+   * bound to this instance.
+   */
+  const buffio::coroStackStats &stackStats() const { return stacks.stats(); }
+
+  /**
+   * @brief starts the compute workers running the functions given to
+   * buffio::offload() by the routines of this loop, apart from the
+   * sockBroker workers.
+   * @return 0 on success, value below 0 on error.
+   */
+  int computeWorkers(int workerNum, size_t order = BUFFIO_COMPUTE_ORDER) {
+    return compute.start(workerNum, order, homeNode);
+  };
+  buffio::computeStats offloadStats() const { return compute.stats(); }
+
+  /**
+   * @brief lets the number of sockBroker workers follow the queued
+   * requests between the bounds of policy, see sockBroker::setScaling().
+   * @return 0 on success, value below 0 on invalid bounds.
+   */
+  int setScaling(const buffio::workerScaling &policy) {
+    return poller.setScaling(policy);
+  };
+  buffio::workerScalingStats scalingStats() const {
+    return poller.scalingStats();
+  };
+  /**
+   * @brief how the sockBroker workers were woken, see sockBroker::wake().
+   */
+  buffio::parkingStats wakeStats() const { return poller.wakeStats(); }
+  /**
+   * @brief how the completed requests came back from the sockBroker
+   * workers, see sockBroker::publish().
+   */
+  buffio::completionStats completionStats() const {
+    return poller.completions();
+  };
 
 private:
   void handleThreaded(int cycle = 8);
@@ -125,6 +424,11 @@ private:
    * @return -1 on error
    */
   int processEvents(struct epoll_event evnts[], int len);
+  /**
+   * @brief waits for the epoll events, spinning first in busy-poll mode.
+   * @return number of events, or value below 0 on error.
+   */
+  int pollEvents(struct epoll_event evnts[], int len, int timeout);
   /**
    * @brief Executes a fixed number of fd events. only called when any fd is
    * used with epoll edge-triggered
@@ -154,34 +458,107 @@ private:
    * @brief method to execute the coroutines.
    *
    * yieldQueue method is used to the task if there's any, and it execute
-   * tasks in chunks. means if the chunk is 10, it try to execute 10 tasks, it
-   * there task less than 10, then the task is executed in a cyclic way, and
+   * tasks for a time budget. tasks are executed in a cyclic way, and
    * based on the status of the task and queue, the yieldQueue returns.
    *
    * it returns only when on of the following happen,
    *  1) while executing the queue become empty.
-   *  2) The cycle is finished
+   *  2) The budget is used up, so I/O is polled again.
    *  3) Some internal error occured.
    *
-   * @param[in] chunk the number of tasks to process in one shot.
+   * @param[in] budget time in ns to run tasks for in one shot.
    * @return return value less than 0 must be treated as error, and must be
    * taken care of.
    */
 
-  int yieldQueue(int chunk);
+  int yieldQueue(uint64_t budget);
+  /**
+   * @brief charges a timed resume of ran ns to the routine picked and
+   * handles an overrun, last is updated if the routine was demoted.
+   */
+  void chargeSlice(uint64_t ran, blockQueue *&last);
+
+  /**
+   * @brief keeps the run queue fed from the steal deque, and steals from
+   * the peers once both are empty.
+   * @return number of routines moved to the run queue.
+   */
+  size_t balance();
+  size_t drainRunnable(size_t batch);
+  size_t steal(size_t batch);
+  bool groupIdle(int *timeout, bool idle);
 
+  /**
+   * @brief moves up to cycle io_uring completions to the run queue.
+   */
+  void reapRing(int cycle);
+  /**
+   * @brief resumes the routine of a finished (or aborted) request, its
+   * deadline is disarmed first. entry is null when an async action handed
+   * its routine to the steal deque.
+   */
+  void completed(buffioHeader *header) {
+    if (header->timerTick != 0)
+      timerClock.disarm(header);
+    if (header->entry != nullptr)
+      queue.push(header->entry);
+  };
+  /**
+   * @brief aborts a pending request, its routine resumes with code in
+   * opError.
+   * @return false if the request can't be aborted (anymore).
+   */
+  bool abortHeader(buffioHeader *header, int code);
+  /**
+   * @brief resumes the routines of expired timers and aborts the requests
+   * past their deadline.
+   */
+  void expireTimers();
   void processThreadRequest();
   void dequeueThreadQueue(int nentry);
-  void shutWorker(int workerNum, int tries, long wait);
+  /**
+   * @brief moves up to cycle posted routines to the run queue.
+   */
+  void drainInbox(int cycle);
+  int enqueuePost(const buffio::postTask &item);
+  size_t shutWorker(int workerNum, int tries, long wait);
 
+  // declared first, so they are destroyed after every other member.
+  buffio::framePool frames;
+  buffio::coroStacks stacks;
+  buffio::Memory<buffioHeader> clampHeaders; // headers of fiber::clamper.
   buffio::Fd evFd;
   buffio::sockBroker poller;
+  buffio::computePool compute;
   buffio::Clock timerClock;
-  buffio::Queue<> queue;
+  buffio::runQueue queue;
   buffio::Queue<buffioHeader, void *, buffioQueueNoMem> requestBatch;
   buffio::Queue<buffioHeader, void *, buffioQueueNoMem> threadRequestBatch;
   buffio::thread threadPool;
+  buffio::uring ring;
+  buffio::fiber::loopState state;
+  buffio::lfqueue<buffio::postTask> inbox;
+  std::atomic<bool> inboxSignal = false; // set by the post that woke us.
+  std::atomic<bool> alive = false;
+  std::atomic<size_t> postWakes = 0;
+  buffio::busyPollStats busy;
+  buffio::timeSliceStats slice;
+  size_t busySkip = 0;
+  size_t busyBackoff = 16;
+  buffio::stealGroup *group = nullptr;
+  size_t groupSelf = 0;
+  size_t stealNext = 0;
+  size_t stealCount = 0;
+  bool groupIdling = false; // counted in group->idle.
   int workerlNum;
+  int homeNode = -1; // numa node of the loop and its workers, -1 none.
+  size_t bufferSize = 4096;
+  size_t bufferNum = 64;
   bool immediateWake = false;
+#if defined(BUFFIO_URING_DEFAULT)
+  buffioBackend backendType = buffioBackend::uring;
+#else
+  buffioBackend backendType = buffioBackend::epoll;
+#endif
 };
 }; // namespace buffio
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "buffio/scheduler.hpp"
+#include "buffio/thread.hpp"
+#include <atomic>
+
+/**
+ * @file shard.hpp
+ * @author Harsh Sharma
+ * @brief Thread-per-core launcher for buffio schedulers.
+ *
+ * shards starts N independent schedulers, each one on its own thread
+ * pinned to its own core, every shard owns its own Queue<>, Clock, epoll
+ * instance and sockBroker workers, nothing is shared between them.
+ */
+
+namespace buffio {
+
+/**
+ * @class shards
+ * @brief launches and joins a set of sharded event loops.
+ *
+ * @details
+ * The scheduler of every shard is constructed on the shard thread itself,
+ * so the per-thread fiber context is bound to it, then the setup routine
+ * is called to push the initial tasks and the loop is run until it has no
+ * work left.
+ *
+ * Typical lifecycle:
+ * 1. Create shards instance
+ * 2. start() with the setup routine
+ * 3. join() to wait for every loop to finish
+ *
+ * ```cpp
+ *  int setup(buffio::scheduler &loop, int shardId, void *data) {
+ *    loop.push(server(shardId));
+ *    return 0;
+ *  };
+ *  buffio::shards runtime;
+ *  runtime.start(4, setup, nullptr);
+ *  runtime.join();
+ * ```
+ */
+class shards {
+public:
+  /**
+   * @brief routine called on the shard thread before the loop is run,
+   * a return value below 0 skips running the loop.
+   */
+  using setupRoutine = int (*)(buffio::scheduler &loop, int shardId,
+                               void *data);
+
+  shards() : shard(nullptr), deques(nullptr), shardNum(0) {};
+  shards(shards const &) = delete;
+  shards &operator=(shards const &) = delete;
+  ~shards();
+
+  /**
+   * @brief starts shardNum event loops.
+   *
+   * @param[in] shardNum number of schedulers to start
+   * @param[in] setup routine to push the initial work on every shard
+   * @param[in] data user data passed to the setup routine
+   * @param[in] workerNum number of sockBroker workers of every shard
+   * @param[in] queueOrder order of the worker queues of every shard
+   * @param[in] pin pin shard i to the cpu (i % online cpus)
+   *
+   * @return buffioErrorCode::none on success, value below 0 on error
+   */
+  [[nodiscard]]
+  int start(int shardNum, setupRoutine setup, void *data, int workerNum = 2,
+            int queueOrder = 5, bool pin = true);
+
+  /**
+   * @brief enables work-stealing between the shards, must be called
+   * before start().
+   *
+   * every shard gets a steal deque of 2^order entries, routines pushed
+   * with scheduler::spawn() (and accepted connection handlers) go there
+   * and idle shards steal them from their busy peers. a shard out of work
+   * keeps stealing, the loops return only once every shard is idle.
+   */
+  void steal(bool enable, size_t order = 10) {
+    stealing = enable;
+    stealOrder = order;
+  };
+
+  /**
+   * @brief waits until every shard returns from run().
+   */
+  void join();
+
+  size_t num() const { return shardNum; }
+
+  /**
+   * @brief returns the scheduler of the shard, valid only while the
+   * shard is running, nullptr otherwise.
+   */
+  buffio::scheduler *get(int shardId) const;
+
+  /**
+   * @brief returns the error code of the shard, set once it exits.
+   */
+  int error(int shardId) const;
+
+  /**
+   * @brief number of routines the shard stole from its peers, set once
+   * the shard exits.
+   */
+  size_t stolen(int shardId) const;
+
+private:
+  struct shardInfo {
+    shards *parent;
+    int id;
+    int cpu;
+    int workerNum;
+    int queueOrder;
+    std::atomic<int> errorCode;
+    std::atomic<buffio::scheduler *> loop;
+    size_t stolen;
+  };
+
+  static int shardMain(void *data);
+  /**
+   * @brief waits until every launched shard reached the same point, the
+   * frame pool of a shard is freed only after all of them are past it.
+   */
+  void rendezvous(std::atomic<size_t> &count);
+  void leave();
+
+  buffio::thread threads;
+  shardInfo *shard;
+  buffio::stealDeque<void *> *deques;
+  buffio::stealGroup group;
+  bool stealing = false;
+  bool joined = false;
+  std::atomic<bool> launched = false;
+  std::atomic<size_t> finished = 0; // shards out of run().
+  std::atomic<size_t> cleaned = 0;  // shards done with clean().
+  size_t stealOrder = 10;
+  setupRoutine setup = nullptr;
+  void *data = nullptr;
+  size_t shardNum;
+};
+
+}; // namespace buffio
@@ -5,16 +5,53 @@
 #include "fiber.hpp"
 
 #include "lfqueue.hpp"
+#include "parking.hpp"
 #include "thread.hpp"
-#include <semaphore.h>
+#include <atomic>
+#include <climits>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
 
 #define BUFFIO_REQUEST_MAX_SIZE sizeof(buffioRequestMaxSize)
+// completions a worker holds before publishing them to the loop.
+#define BUFFIO_COMPLETION_BATCH 16
+// nor holds them longer than this while more requests are queued, nor
+// across any action but a file transfer.
+#define BUFFIO_COMPLETION_HOLD_NS 50000
 using buffioSockBrokerQueue = buffio::lfqueue<buffioHeader *>;
 
 namespace buffio {
+
+/**
+ * @brief bounds of an elastic worker pool, see sockBroker::setScaling().
+ */
+struct workerScaling {
+  int minWorkers = 1; ///< idle workers retire down to this count.
+  int maxWorkers = 1; ///< workers spawned up to this count.
+  size_t spawnDepth = 4;     ///< queued requests per worker counted as high.
+  long spawnAfterUs = 1000;  ///< high that long before a worker is spawned.
+  long idleMs = 5000;        ///< parked that long, a worker retires.
+};
+
+/**
+ * @brief scaling events of an elastic worker pool.
+ */
+struct workerScalingStats {
+  size_t spawned = 0; ///< workers spawned on load.
+  size_t retired = 0; ///< workers retired once idle.
+  size_t peak = 0;    ///< most workers alive at once.
+};
+
+/**
+ * @brief delivery of the completed requests to the loop.
+ */
+struct completionStats {
+  size_t completed = 0; ///< requests handed back to the loop.
+  size_t batches = 0;   ///< chains published by the workers.
+  size_t signals = 0;   ///< eventfd writes done for them.
+};
+
 class sockBroker {
 public:
   // the main thread worker code inlined with the code to
@@ -26,32 +63,48 @@ public:
   sockBroker &operator=(sockBroker const &) = delete;
   sockBroker(sockBroker const &&) = delete;
   sockBroker &operator=(sockBroker const &&) = delete;
-  sockBroker() : epollFd(-1), count(0), wakefd(0) {
+  sockBroker()
+      : epollFd(-1), wakefd(0), count(0), state(nullptr), spinning(0),
+        spinHits(0), spinMax(0), finished(nullptr), drained(nullptr),
+        batches(0), signals(0), delivered(0), threads(nullptr), node(-1),
+        depth(0), retireFloor(INT_MAX), idleMs(0), retired(0) {
     sockBrokerState = buffioSockBrokerState::none;
   };
 
   ~sockBroker() {}
 
-  int start(buffio::thread &thread, int &workerNum, size_t queueOrder = 5);
+  /**
+   * @param[in] node numa node the workers run on, -1 anywhere.
+   */
+  int start(buffio::thread &thread, buffio::fiber::loopState *loopState,
+            int &workerNum, size_t queueOrder = 5, int node = -1);
 
   inline bool push(buffioHeaderType *which) {
     if (sockBrokerState == buffioSockBrokerState::active) {
+      if (!epollWorks.enqueue(which))
+        return false;
       count += 1;
-
-      return epollWorks.enqueue(which);
+      // counted once queued, a worker claiming it always finds it.
+      depth.fetch_add(1, std::memory_order_seq_cst);
+      return true;
     }
     return false;
   }
+  /**
+   * @brief next completed request, oldest first, loop thread only.
+   */
   inline buffioHeaderType *pop() {
-    if (sockBrokerState == buffioSockBrokerState::active) {
-      auto tmp = epollConsume.dequeue(nullptr);
-      if (tmp != nullptr) {
-        count -= 1;
-        return tmp;
-      }
+    if (sockBrokerState != buffioSockBrokerState::active)
+      return nullptr;
+    if (drained == nullptr)
+      drained = detach();
+    auto tmp = drained;
+    if (tmp != nullptr) {
+      drained = tmp->next;
+      count -= 1;
+      delivered += 1;
     };
-
-    return nullptr;
+    return tmp;
   }
 
   bool running() const {
@@ -96,20 +149,112 @@ public:
   int ping() {
     if (!running())
       return (int)buffioErrorCode::epollInstance;
-    ::sem_post(&buffioWorkerSignal);
+    lot.wake(1);
     return 0;
   }
+  /**
+   * @brief wakes the parked workers a batch of pushed requests needs,
+   * loop thread only.
+   *
+   * @details workers spinning on the queue take the first requests, the
+   * rest wake as many parked workers with a single futex call, nothing
+   * when every worker is busy already.
+   */
+  void wake(size_t pushed);
+  /**
+   * @brief wakes every parked worker, on shutdown.
+   */
+  void wakeAll() { lot.wake(INT_MAX); };
+  buffio::parkingStats wakeStats() const;
+  buffio::completionStats completions() const;
   int sendEv() const { return ::eventfd_write(wakefd, 100); };
   inline void mountFd(int fd) { wakefd = fd; }
 
+  /**
+   * @brief makes the worker pool elastic, loop thread only.
+   *
+   * @details
+   * - a worker is spawned, up to maxWorkers, once the requests queued per
+   *   live worker stay above spawnDepth for spawnAfterUs, checked by the
+   *   loop every iteration through scale().
+   * - a worker parked for idleMs with nothing queued retires, as long as
+   *   more than minWorkers are alive.
+   *
+   * @return 0 on success, buffioErrorCode::workerNum on invalid bounds.
+   */
+  int setScaling(const buffio::workerScaling &policy);
+  bool elastic() const { return scaling.maxWorkers > scaling.minWorkers; }
+  /**
+   * @brief spawns a worker if the queue stayed deep, and reaps the
+   * retired ones, loop thread only.
+   */
+  void scale() {
+    if (elastic() || retired.load(std::memory_order_relaxed) != reaped)
+      adjust();
+  };
+  buffio::workerScalingStats scalingStats() const;
+
 private:
+  /**
+   * @brief spins on the queue for a while, then parks the worker until
+   * woken.
+   * @return false once idle for idleMs, when the pool is elastic.
+   */
+  bool park(long &spin);
+  /**
+   * @brief takes the idle worker out of the pool if more than minWorkers
+   * are alive and nothing is queued.
+   */
+  bool retire();
+  int spawn();
+  void adjust();
+  /**
+   * @brief takes one of the queued requests for the calling worker.
+   * @return false if none is left unclaimed.
+   */
+  bool claim();
+  bool queued() const { return depth.load(std::memory_order_seq_cst) > 0; }
+  /**
+   * @brief hands a chain of completed requests, newest first and linked
+   * through next, to the loop and signals it once.
+   */
+  void publish(buffioHeader *head, buffioHeader *tail, size_t num);
+  /**
+   * @brief takes every published completion at once, oldest first.
+   */
+  buffioHeader *detach();
+
   buffioSockBrokerQueue epollWorks;
-  buffioSockBrokerQueue epollConsume;
   buffioSockBrokerState sockBrokerState;
   int epollFd;
   int wakefd;
   size_t count;
-  sem_t buffioWorkerSignal;
+  buffio::fiber::loopState *state;
+  buffio::parkingLot lot;
+  std::atomic<int> spinning; // workers spinning on an empty queue.
+  std::atomic<size_t> spinHits;
+  long spinMax; // pause rounds, 0 on a single cpu.
+  // completed requests, chains pushed by the workers and detached whole by
+  // the loop, linked through the headers so it never fills up.
+  __attribute__((aligned(BUFFIO_CACHE_BYTES)))
+  std::atomic<buffioHeader *> finished;
+  buffioHeader *drained; // loop thread only, detached and not popped yet.
+  std::atomic<size_t> batches;
+  std::atomic<size_t> signals;
+  size_t delivered;
+
+  buffio::thread *threads; // runs the workers, set by start().
+  int node;
+  std::atomic<ssize_t> depth; // requests queued, not claimed by a worker yet.
+  std::atomic<int> retireFloor; // workers retire while more are alive.
+  std::atomic<long> idleMs;
+  std::atomic<size_t> retired;
+  // loop thread only.
+  buffio::workerScaling scaling;
+  buffio::workerScalingStats events;
+  uint64_t highSince = 0;
+  size_t reaped = 0;
+  buffio::parkingStats wakes;
 };
 
 }; // namespace buffio
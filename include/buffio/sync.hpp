@@ -0,0 +1,215 @@
+#ifndef __BUFFIO_SYNC_HPP__
+#define __BUFFIO_SYNC_HPP__
+
+#include "buffio/promise.hpp"
+#include "buffio/waitlist.hpp"
+#include <atomic>
+#include <sys/types.h>
+
+/*
+ * synchronisation between routines: a routine that can't take a mutex or
+ * a permit is suspended, its run queue entry parked on a FIFO wait list,
+ * and resumed by the release that hands the mutex (or permit) to it, the
+ * loop keeps running the other routines meanwhile.
+ *
+ *   buffio::mutex lock;
+ *   buffiowait lock.lock();
+ *   ...
+ *   lock.unlock();
+ *
+ * the objects can be shared by the routines of different loops (see
+ * buffio::shards), a routine is always resumed on its own loop, through
+ * scheduler::post when it is released from another thread.
+ */
+
+namespace buffio {
+
+/**
+ * @brief guard of the wait lists, only held for a few instructions, so
+ * spinning beats parking the thread.
+ */
+struct syncGuard {
+  std::atomic<bool> held = false;
+  void lock();
+  void unlock() { held.store(false, std::memory_order_release); }
+};
+
+/**
+ * @brief awaited tags of mutex::lock(), semaphore::acquire() and
+ * condition::wait().
+ */
+struct mutexLock {
+  buffio::mutex *lock;
+};
+struct semaphoreAcquire {
+  buffio::semaphore *sem;
+};
+struct conditionWait {
+  buffio::condition *cond;
+  buffio::mutex *lock;
+};
+
+/**
+ * @class mutex
+ * @brief mutual exclusion between routines, of one loop or of several.
+ *
+ * @details
+ * - lock() and unlock() are one compare and swap while nobody waits, no
+ *   syscall and no allocation.
+ * - unlock() hands the mutex straight to the first parked routine, so
+ *   waiters get it in arrival order and a running routine can't barge
+ *   ahead of them.
+ * - not recursive, unlock() can be called from any thread, not only the
+ *   one of the routine that locked it.
+ */
+class mutex {
+public:
+  mutex() = default;
+  mutex(mutex const &) = delete;
+  mutex &operator=(mutex const &) = delete;
+
+  /**
+   * @brief awaited, resumes with the mutex held.
+   */
+  buffio::mutexLock lock() { return {this}; };
+  bool tryLock() {
+    int expected = unowned;
+    return state.compare_exchange_strong(expected, owned,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+  };
+  void unlock();
+  bool locked() const {
+    return state.load(std::memory_order_relaxed) != unowned;
+  };
+
+private:
+  friend buffio::mutexAwaiter;
+  friend buffio::conditionAwaiter;
+  friend buffio::condition;
+
+  /**
+   * @brief takes the mutex for the parked routine of node or queues it,
+   * called with the guard held.
+   * @return true if the routine got the mutex.
+   */
+  bool acquireOrPark(waitNode *node);
+
+  static constexpr int unowned = 0;
+  static constexpr int owned = 1;
+  static constexpr int contended = 2; // owned, and routines are parked.
+
+  std::atomic<int> state = unowned;
+  buffio::syncGuard guard;
+  buffio::waitList waiters;
+};
+
+/**
+ * @class semaphore
+ * @brief counting semaphore between routines, of one loop or of several.
+ *
+ * @details
+ * - acquire() takes a permit with one compare and swap while there are
+ *   some, release() gives a permit to the first parked routine before
+ *   making it available to the others.
+ */
+class semaphore {
+public:
+  explicit semaphore(size_t permits) : count((ssize_t)permits) {};
+  semaphore(semaphore const &) = delete;
+  semaphore &operator=(semaphore const &) = delete;
+
+  /**
+   * @brief awaited, resumes with a permit taken.
+   */
+  buffio::semaphoreAcquire acquire() { return {this}; };
+  bool tryAcquire() {
+    ssize_t permits = count.load(std::memory_order_relaxed);
+    while (permits > 0)
+      if (count.compare_exchange_weak(permits, permits - 1,
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed))
+        return true;
+    return false;
+  };
+  void release(size_t permits = 1);
+  size_t available() const {
+    return (size_t)count.load(std::memory_order_relaxed);
+  };
+
+private:
+  friend buffio::semaphoreAwaiter;
+
+  std::atomic<ssize_t> count;
+  buffio::syncGuard guard;
+  buffio::waitList waiters;
+};
+
+/**
+ * @class condition
+ * @brief condition variable of routines, used with a buffio::mutex.
+ *
+ * @details
+ * - wait() is awaited with the mutex held, it parks the routine and
+ *   unlocks the mutex, the routine resumes with the mutex held again.
+ * - a notified routine is moved to the wait list of the mutex instead of
+ *   being resumed just to park on the mutex, notifyAll() wakes them one
+ *   by one as the mutex is handed over.
+ * - as with std::condition_variable the condition has to be checked again
+ *   after the wait.
+ */
+class condition {
+public:
+  condition() = default;
+  condition(condition const &) = delete;
+  condition &operator=(condition const &) = delete;
+
+  /**
+   * @brief awaited with lock held, resumes once notified with lock held.
+   */
+  buffio::conditionWait wait(buffio::mutex &lock) { return {this, &lock}; };
+  void notifyOne();
+  void notifyAll();
+
+private:
+  friend buffio::conditionAwaiter;
+
+  static void relock(waitNode *node);
+
+  buffio::syncGuard guard;
+  buffio::waitList waiters;
+};
+
+/**
+ * @brief awaiters of the tags, they park in await_suspend, where the node
+ * has its final address, and don't suspend if they got it meanwhile.
+ */
+struct mutexAwaiter {
+  bool await_ready() const noexcept { return ready; }
+  bool await_suspend(std::coroutine_handle<> h) noexcept;
+  void await_resume() noexcept {};
+  buffio::mutex *lock;
+  buffio::waitNode node;
+  bool ready;
+};
+
+struct semaphoreAwaiter {
+  bool await_ready() const noexcept { return ready; }
+  bool await_suspend(std::coroutine_handle<> h) noexcept;
+  void await_resume() noexcept {};
+  buffio::semaphore *sem;
+  buffio::waitNode node;
+  bool ready;
+};
+
+struct conditionAwaiter {
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) noexcept;
+  void await_resume() noexcept {};
+  buffio::condition *cond;
+  buffio::waitNode node;
+};
+
+}; // namespace buffio
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef __BUFFIO_TASK_HPP__
+#define __BUFFIO_TASK_HPP__
+
+#include "buffio/promise.hpp"
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+/*
+ * typed routines: the value given to co_return (or the exception that left
+ * the routine) is kept in the coroutine frame and handed to the routine
+ * awaiting it, no allocation beyond the frame itself.
+ *
+ *   buffio::task<std::string> readLine(buffio::Fd &fd);
+ *
+ *   buffio::promise session(buffio::Fd &fd) {
+ *     std::string line = buffiowait readLine(fd);
+ *     ...
+ *   }
+ *
+ * a task converts to buffio::promise, so it can also be pushed, posted or
+ * spawned like any routine, its result is dropped then.
+ */
+
+namespace buffio {
+
+/**
+ * @brief result slot of a typed routine, empty until the routine returns.
+ */
+template <typename T> class taskResult : public buffio::promiseBase {
+public:
+  template <typename U = T>
+    requires std::is_convertible_v<U &&, T>
+  void return_value(U &&value) {
+    result.template emplace<1>(std::forward<U>(value));
+    status = buffioRoutineStatus::done;
+  };
+
+  void unhandled_exception() {
+    result.template emplace<2>(std::current_exception());
+    status = buffioRoutineStatus::unhandledException;
+  };
+
+  /**
+   * @brief moves the result out, rethrows the exception of the routine.
+   */
+  T take() {
+    if (result.index() == 2)
+      std::rethrow_exception(std::get<2>(result));
+    assert(result.index() == 1);
+    return std::move(std::get<1>(result));
+  };
+
+private:
+  std::variant<std::monostate, T, std::exception_ptr> result;
+};
+
+template <> class taskResult<void> : public buffio::promiseBase {
+public:
+  void return_void() { status = buffioRoutineStatus::done; };
+
+  void unhandled_exception() {
+    error = std::current_exception();
+    status = buffioRoutineStatus::unhandledException;
+  };
+
+  void take() {
+    if (error)
+      std::rethrow_exception(error);
+  };
+
+private:
+  std::exception_ptr error;
+};
+
+/**
+ * @class task
+ * @brief routine producing a value of type T.
+ *
+ * @details
+ * - move only, the task owns the frame until it is awaited or converted to
+ *   buffio::promise, a task dropped before that destroys its frame.
+ * - T can be move only, it is moved out of the frame when awaited.
+ * - awaiting it works like awaiting a buffio::promise, the routine runs
+ *   right away in the place of its caller.
+ */
+template <typename T> class task {
+  static_assert(!std::is_reference_v<T>,
+                "buffio::task can't return a reference, return a pointer");
+
+public:
+  class promise_type : public buffio::taskResult<T> {
+  public:
+    task get_return_object() {
+      return task(std::coroutine_handle<promise_type>::from_promise(*this));
+    };
+  };
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  // stolen frames are rebuilt from their address as a plain routine.
+  static_assert(alignof(promise_type) ==
+                alignof(buffio::promise::promise_type));
+
+  explicit task(handle_type _handle) : handle(_handle) {};
+  task(task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {};
+  task &operator=(task &&other) noexcept {
+    if (this != &other) {
+      if (handle)
+        handle.destroy();
+      handle = std::exchange(other.handle, nullptr);
+    };
+    return *this;
+  };
+  task(task const &) = delete;
+  task &operator=(task const &) = delete;
+  ~task() {
+    if (handle)
+      handle.destroy();
+  };
+
+  /**
+   * @brief gives the frame away as an untyped routine, for
+   * scheduler::push()/post()/spawn() and buffio::taskGroup.
+   */
+  operator buffio::promise() && {
+    handle_type routine = release();
+    return buffio::promise(routine, &routine.promise());
+  };
+
+  handle_type release() { return std::exchange(handle, nullptr); };
+
+private:
+  handle_type handle;
+};
+
+/**
+ * @brief awaiter of a task, resumes with the result of the routine.
+ */
+template <typename T> struct taskAwaiter {
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+    return next;
+  };
+  T await_resume() {
+    // the frame goes away whether the routine returned or threw.
+    struct release {
+      typename buffio::task<T>::handle_type frame;
+      ~release() { frame.destroy(); };
+    } guard{child};
+    return child.promise().take();
+  };
+  typename buffio::task<T>::handle_type child;
+  std::coroutine_handle<> next;
+};
+
+template <typename T>
+buffio::taskAwaiter<T>
+promiseBase::await_transform(buffio::task<T> &&child) {
+  auto routine = child.release();
+  return {.child = routine,
+          .next = call(buffio::promise(routine, &routine.promise()))};
+};
+
+}; // namespace buffio
+
+#endif
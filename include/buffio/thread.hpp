@@ -135,6 +135,21 @@ private:
 };
 
 namespace buffio {
+
+/**
+ * @brief where a thread runs, -1 leaves the choice to the kernel.
+ *
+ * @details
+ * - cpu pins the thread to that cpu, node alone lets it float on the cpus
+ *   of the node.
+ * - the stack and the memory the thread allocates are taken from node (or
+ *   from the node of cpu) while it has free pages.
+ */
+struct threadPlacement {
+  int cpu = -1;
+  int node = -1;
+};
+
 class thread {
   struct threadinternal {
     void *resource;
@@ -147,6 +162,7 @@ class thread {
     pthread_t id;
     std::atomic<buffioThreadStatus> status;
     std::atomic<size_t> *numThreads;
+    int node; // memory policy applied by the thread itself, -1 none.
   };
 
 public:
@@ -160,9 +176,23 @@ public:
   // only free the allocated resource for the thread not terminate it
   void free();
   int run(const char *name, int (*func)(void *), void *data,
-          size_t stackSize = buffio::thread::SD);
+          size_t stackSize = buffio::thread::SD,
+          buffio::threadPlacement where = {});
+  /**
+   * @brief applies the placement to the calling thread.
+   * @return 0 on success, buffioErrorCode::affinity otherwise.
+   */
+  static int pin(buffio::threadPlacement where);
 
   void wait(pthread_t threadId) { ::pthread_join(threadId, NULL); }
+  // wait for every thread started by the instance to exit
+  void join();
+  /**
+   * @brief joins the threads that already returned and frees their stacks,
+   * the others are left running.
+   * @return number of threads reaped.
+   */
+  size_t reap();
   size_t num() const { return numThreads.load(std::memory_order_acquire); }
   static int setname(const char *name) {
     return ::prctl(PR_SET_NAME, name, 0, 0, 0);
@@ -0,0 +1,53 @@
+#ifndef __BUFFIO_TOPOLOGY_HPP__
+#define __BUFFIO_TOPOLOGY_HPP__
+
+#include <cstddef>
+#include <sched.h>
+
+/*
+ * cpu and numa layout of the machine, read once from sysfs, and the
+ * memory policy calls buffio needs to keep a loop, its workers and their
+ * memory on one node. no libnuma needed, a machine (or kernel) without
+ * numa shows as a single node holding every cpu.
+ */
+
+namespace buffio {
+
+class topology {
+public:
+  /**
+   * @brief number of numa nodes, 1 without numa.
+   */
+  static int nodes();
+  /**
+   * @brief node of the cpu, 0 if unknown.
+   */
+  static int nodeOf(int cpu);
+  /**
+   * @brief fills set with the cpus of the node.
+   * @return 0 on success, -1 if the node doesn't exist.
+   */
+  static int cpusOf(int node, cpu_set_t *set);
+  /**
+   * @brief node the calling thread is confined to by its affinity.
+   * @return -1 if the thread may run on the cpus of several nodes.
+   */
+  static int affinityNode();
+
+  /**
+   * @brief memory the calling thread faults in from now on is taken from
+   * node while it has free pages.
+   * @return 0 on success, -1 on error.
+   */
+  static int preferNode(int node);
+  /**
+   * @brief same as preferNode() for the pages of a mapping not touched
+   * yet, addr must be page aligned.
+   * @return 0 on success, -1 on error.
+   */
+  static int bindMemory(void *addr, size_t len, int node);
+};
+
+}; // namespace buffio
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef __BUFFIO_URING_HPP__
+#define __BUFFIO_URING_HPP__
+
+/**
+ * @file uring.hpp
+ * @author Harsh Sharma
+ * @brief io_uring backend of buffio.
+ *
+ * uring is a thin wrapper over the raw io_uring system calls, no liburing
+ * dependency. One instance is owned by every scheduler running with the
+ * buffioBackend::uring backend.
+ *
+ * - Fd::wait* and async* methods prepare sqe's, nothing is submitted
+ *   until the scheduler calls submit() once per run() iteration.
+ * - The scheduler eventfd is registered with the ring, so a posted cqe
+ *   wakes the epoll_wait of the loop, and the cqe's are reaped directly
+ *   into the run queue.
+ * - Regular files are kept in a registered file table and can be read
+ *   and written through a registered buffer arena, so file I/O needs no
+ *   worker thread when the kernel tracks the file position for us.
+ */
+
+#include "buffio/common.hpp"
+#include "buffio/enum.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// <linux/io_uring.h> is included by src/uring.cpp only, it defines
+// macros (BLOCK_SIZE among them) that must not reach the users.
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace buffio {
+
+class uring {
+public:
+  uring();
+  uring(uring const &) = delete;
+  uring &operator=(uring const &) = delete;
+  ~uring() { release(); };
+
+  /**
+   * @brief creates the ring and maps the submission and completion queues.
+   *
+   * @param[in] entries number of sqe's, rounded up to a power of 2 by the
+   * kernel
+   * @param[in] eventFd eventfd to signal on every completion, -1 for none
+   *
+   * @return buffioErrorCode::none on success, value below 0 if the kernel
+   * has no io_uring or misses one of the opcodes buffio relies on.
+   */
+  [[nodiscard]]
+  int init(unsigned entries, int eventFd = -1);
+  void release();
+  bool active() const { return (ringFd >= 0); }
+
+  /*
+   * operation preparation, the result of the operation is given back to
+   * the header by complete(), user_data of every sqe is the header.
+   */
+  int read(buffioHeader *header, uint64_t offset = 0, int slot = -1);
+  int write(buffioHeader *header, uint64_t offset = 0, int slot = -1);
+  int accept(buffioHeader *header);
+  int connect(buffioHeader *header);
+  int pollAdd(buffioHeader *header, unsigned mask);
+
+  /**
+   * @brief cancels the operation in flight for the header and waits for
+   * its completion, any other completion reaped meanwhile is kept for
+   * complete(). used before the memory of the header goes away.
+   */
+  void cancel(buffioHeader *header);
+  /**
+   * @brief prepares a cancel for the operation in flight for the header
+   * without waiting, the operation completes with -ECANCELED (or its
+   * result, if it was done already) through complete().
+   * @return 0 on success, -1 if the submission queue is full.
+   */
+  int abort(buffioHeader *header);
+
+  /**
+   * @brief submits every prepared sqe with a single io_uring_enter.
+   * @return number of sqe's consumed by the kernel, or -errno.
+   */
+  int submit();
+
+  /**
+   * @brief pops one completion.
+   *
+   * @param[out] header header the completion belongs to
+   * @param[out] res result of the operation, -errno on error
+   * @return false if the completion queue is empty
+   */
+  bool complete(buffioHeader **header, int *res);
+
+  /**
+   * @brief true if the kernel reads and writes at the current file
+   * position (offset -1), required to move files off the worker threads.
+   */
+  bool files() const { return active() && filePos; }
+
+  /**
+   * @brief puts the fd in the registered file table.
+   * @return slot to pass to read()/write(), -1 if the table is full or
+   * the kernel does not support sparse file tables.
+   */
+  int registerFile(int fd);
+  void unregisterFile(int slot);
+
+  /**
+   * @brief registers an arena of blockNum buffers of blockSize bytes,
+   * read()/write() on a buffer of the arena use the fixed buffer opcodes.
+   * @return buffioErrorCode::none on success, value below 0 on error.
+   */
+  int registerBuffers(size_t blockSize, size_t blockNum);
+  /**
+   * @brief takes a block of the registered arena.
+   * @return nullptr if the arena is exhausted or not registered.
+   */
+  char *getBuffer();
+  /**
+   * @brief gives a block back to the arena.
+   * @return false if the buffer does not belong to the arena.
+   */
+  bool putBuffer(char *buffer);
+  size_t bufferSize() const { return blockSize; }
+
+  size_t inflight() const { return inFlight; }
+  size_t prepared() const { return sqLocalTail - sqTailSubmitted; }
+
+private:
+  io_uring_sqe *getSqe();
+  int prepareRw(buffioHeader *header, bool write, uint64_t offset, int slot);
+  int bufferIndex(const char *buffer, size_t len) const;
+  bool reap(uint64_t *data, int *res);
+
+  struct stashed {
+    buffioHeader *header;
+    int res;
+  };
+
+  int ringFd;
+  unsigned *sqHead;
+  unsigned *sqTail;
+  unsigned *sqMask;
+  unsigned *sqArray;
+  unsigned sqEntries;
+  unsigned sqLocalTail;
+  unsigned sqTailSubmitted;
+  io_uring_sqe *sqes;
+
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned *cqMask;
+  io_uring_cqe *cqes;
+
+  void *sqPtr;
+  void *cqPtr;
+  size_t sqSize;
+  size_t cqSize;
+  size_t sqesSize;
+
+  size_t inFlight;
+  uint64_t cancelSeq;
+  std::deque<stashed> stash;
+
+  bool filePos;
+  std::vector<bool> fileSlots;
+
+  char *arena;
+  size_t blockSize;
+  size_t blockNum;
+  std::vector<unsigned> freeBlocks;
+};
+
+}; // namespace buffio
+#endif
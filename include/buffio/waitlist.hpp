@@ -0,0 +1,59 @@
+#ifndef __BUFFIO_WAITLIST_HPP__
+#define __BUFFIO_WAITLIST_HPP__
+
+#include "buffio/common.hpp"
+
+/*
+ * routines parked on a channel or a synchronisation object: the node lives
+ * in the awaiter kept in the frame of the routine, so parking allocates
+ * nothing, and the routine is resumed on the loop it was parked from.
+ */
+
+namespace buffio {
+
+class mutex;
+
+/**
+ * @brief routine parked on a wait list.
+ */
+struct waitNode {
+  blockQueue *entry;
+  buffio::scheduler *loop; ///< loop the routine is resumed on.
+  waitNode *next;
+  void *slot;            ///< value a sender offers or a receiver fills.
+  buffio::mutex *relock; ///< mutex to take back, set by condition::wait().
+  bool done;             ///< the value was handed over.
+  bool pending;          ///< counts as a pending request of its loop.
+
+  /**
+   * @brief suspends the running routine, if counted it is a pending
+   * request of its loop until resumed, so the loop waits for it.
+   */
+  void park(bool counted = true);
+  /**
+   * @brief resumes the routine on its loop, thread safe, the node must
+   * not be touched afterwards.
+   */
+  void resume();
+};
+
+/**
+ * @brief FIFO of parked routines, the owner guards it if it is shared
+ * between threads.
+ */
+struct waitList {
+  waitNode *head = nullptr;
+  waitNode *tail = nullptr;
+
+  bool empty() const { return head == nullptr; }
+  void push(waitNode *node);
+  waitNode *pop();
+  /**
+   * @brief resumes the first routine, done tells whether it got its value.
+   */
+  void wake(bool done);
+};
+
+}; // namespace buffio
+
+#endif
@@ -1,16 +1,39 @@
 #include "buffio/actions.hpp"
 #include "buffio/promise.hpp"
+#include "buffio/scheduler.hpp"
 #include <cerrno>
 
 namespace buffio {
 
+/*
+ * a freshly accepted connection has no fd affinity yet, its handler is
+ * offered to the steal deque so an idle shard can serve it.
+ */
+static inline void spawnAccepted(buffioHeader *header, buffio::promise handle) {
+  header->entry = nullptr;
+  if (buffio::fiber::loop != nullptr && buffio::fiber::loop->offer(handle))
+    return;
+
+  header->entry = buffio::fiber::queue->getEntry();
+  buffio::makeContainer::routine(handle, header->entry->task);
+};
+
 action::xeturn action::propBack(buffioHeader *header) {
   header->isFresh = false;
   header->fd->unsetBit(header->aux);
   return;
 };
+action::xeturn action::aborted(buffioHeader *header) {
+  header->isFresh = false;
+  header->opError = header->abortCode;
+  header->len.len = 0;
+  return;
+};
 action::xeturn action::clampThread(buffioHeader *header) {
-  header->entry->task.run(header->entry->task.storage);
+  header->isFresh = false;
+  // not promise::run, there is no run queue here, the routine runs until
+  // it awaits unclamp() and the header goes back to its loop.
+  ((buffio::promise *)header->entry->task.storage)->get().resume();
   return;
 };
 
@@ -27,10 +50,10 @@ action::xeturn action::read(buffioHeader *header) {
   while (buffiolen > 0) {
     buffiolen = ::read(fd, cursor, reserved);
     if (buffiolen > 0) {
+      cursor += buffiolen;
       reserved -= buffiolen;
       if (reserved <= 0)
         break;
-      cursor = buffer + buffiolen;
     };
   };
 
@@ -56,10 +79,10 @@ action::xeturn action::write(buffioHeader *header) {
   while (buffiolen > 0) {
     buffiolen = ::write(fd, cursor, reserved);
     if (buffiolen > 0) {
+      cursor += buffiolen;
       reserved -= buffiolen;
       if (reserved <= 0)
         break;
-      cursor = buffer + buffiolen;
     };
   };
 
@@ -142,8 +165,7 @@ action::xeturn action::asyncAccept(buffioHeader *header) {
   auto handle = header->onAsyncDone.asyncAcceptlocal(header->aux, addr,
                                                      header->len.socklen);
 
-  header->entry = buffio::fiber::queue->getEntry();
-  buffio::makeContainer::routine(handle, header->entry->task);
+  spawnAccepted(header, handle);
 
 };
 action::xeturn action::asyncAcceptIpv4(buffioHeader *header) {
@@ -155,8 +177,7 @@ action::xeturn action::asyncAcceptIpv4(buffioHeader *header) {
   auto handle =
       header->onAsyncDone.asyncAcceptin(header->aux, addr, header->len.socklen);
 
-  header->entry = buffio::fiber::queue->getEntry();
-  buffio::makeContainer::routine(handle, header->entry->task);
+  spawnAccepted(header, handle);
   return;
 };
 action::xeturn action::asyncAcceptIpv6(buffioHeader *header) {
@@ -167,8 +188,7 @@ action::xeturn action::asyncAcceptIpv6(buffioHeader *header) {
   auto handle = header->onAsyncDone.asyncAcceptin6(header->aux, addr,
                                                    header->len.socklen);
 
-  header->entry = buffio::fiber::queue->getEntry();
-  buffio::makeContainer::routine(handle, header->entry->task);
+  spawnAccepted(header, handle);
   return;
 };
 
@@ -213,4 +233,80 @@ action::xeturn action::asyncWriteFile(buffioHeader *header) {
   buffio::makeContainer::routine(handle, header->entry->task);
   return;
 };
+
+action::xeturn action::uringReadWrite(buffioHeader *header) {
+  header->len.len = header->aux > 0 ? header->aux : 0;
+  header->isFresh = false;
+  return;
+};
+
+action::xeturn action::uringAccept(buffioHeader *header) {
+  header->isFresh = false;
+  return;
+};
+
+action::xeturn action::uringConnect(buffioHeader *header) {
+  header->isFresh = false;
+  return;
+};
+
+action::xeturn action::uringPoll(buffioHeader *header) {
+  header->isFresh = false;
+  return;
+};
+
+action::xeturn action::uringAsyncRead(buffioHeader *header) {
+  action::uringReadWrite(header);
+  auto handle = header->onAsyncDone.onAsyncRead(
+      header->opError, header->data.buffer, header->len.len, header->fd);
+  buffio::makeContainer::routine(handle, header->entry->task);
+  return;
+};
+
+action::xeturn action::uringAsyncWrite(buffioHeader *header) {
+  action::uringReadWrite(header);
+  auto handle = header->onAsyncDone.onAsyncWrite(
+      header->opError, header->data.buffer, header->len.len, header->fd);
+  buffio::makeContainer::routine(handle, header->entry->task);
+  return;
+};
+
+/*
+ * the accept sqe of an async accept is re-armed after every completion,
+ * as long as the reserve header stays armed, matching the persistent
+ * behaviour of the epoll path.
+ */
+static inline void uringRearm(buffioHeader *header) {
+  if (!header->isFresh || buffio::fiber::ring == nullptr)
+    return;
+  if (buffio::fiber::ring->accept(header) == 0)
+    buffio::fiber::state->pendingReq.fetch_add(1, std::memory_order_acq_rel);
+};
+
+template <typename T, typename F>
+static inline void uringAccepted(buffioHeader *header, F then) {
+  int afd = header->aux;
+  header->entry = nullptr;
+
+  if (afd >= 0) {
+    T addr = {0};
+    socklen_t len = sizeof(T);
+    ::getpeername(afd, (sockaddr *)&addr, &len);
+    spawnAccepted(header, then(afd, addr, len));
+  };
+  uringRearm(header);
+};
+
+action::xeturn action::uringAsyncAccept(buffioHeader *header) {
+  uringAccepted<sockaddr_un>(header, header->onAsyncDone.asyncAcceptlocal);
+  return;
+};
+action::xeturn action::uringAsyncAcceptIpv4(buffioHeader *header) {
+  uringAccepted<sockaddr_in>(header, header->onAsyncDone.asyncAcceptin);
+  return;
+};
+action::xeturn action::uringAsyncAcceptIpv6(buffioHeader *header) {
+  uringAccepted<sockaddr_in6>(header, header->onAsyncDone.asyncAcceptin6);
+  return;
+};
 }; // namespace buffio
@@ -0,0 +1,125 @@
+#include "buffio/cancel.hpp"
+#include "buffio/scheduler.hpp"
+
+namespace buffio {
+
+void cancelState::bind(cancelState *state, blockQueue *entry) {
+  if (entry->cancel == state)
+    return;
+  if (entry->cancel != nullptr)
+    unbind(entry);
+
+  // run queue entries never migrate, one loop walks the whole list.
+  assert(state->loop == nullptr || state->loop == buffio::fiber::loop);
+  state->loop = buffio::fiber::loop;
+
+  entry->cancel = state;
+  entry->cancelPrev = nullptr;
+  entry->cancelNext = state->bound;
+  if (state->bound != nullptr)
+    state->bound->cancelPrev = entry;
+  state->bound = entry;
+  state->refs += 1;
+};
+
+void cancelState::unbind(blockQueue *entry) {
+  auto state = entry->cancel;
+  entry->cancel = nullptr;
+
+  if (entry->cancelPrev != nullptr)
+    entry->cancelPrev->cancelNext = entry->cancelNext;
+  else
+    state->bound = entry->cancelNext;
+  if (entry->cancelNext != nullptr)
+    entry->cancelNext->cancelPrev = entry->cancelPrev;
+
+  release(state);
+};
+
+cancelState *cancelState::nest(cancelState *outer) {
+  cancelState *state = nullptr;
+  try {
+    state = new cancelState{
+        .bound = nullptr, .loop = nullptr, .refs = 1, .cancelled = false};
+  } catch (std::exception &e) {
+    return nullptr;
+  };
+  if (outer == nullptr)
+    return state;
+
+  // keeps the outer scope alive, cancel() walks down from it.
+  state->cancelled = outer->cancelled;
+  state->outer = outer;
+  state->next = outer->inner;
+  if (outer->inner != nullptr)
+    outer->inner->prev = state;
+  outer->inner = state;
+  outer->refs += 1;
+  return state;
+};
+
+size_t cancelState::cancel(cancelState *state) {
+  if (state->cancelled)
+    return 0;
+  state->cancelled = true;
+
+  size_t aborted = 0;
+  for (blockQueue *entry = state->bound; entry != nullptr;
+       entry = entry->cancelNext) {
+    if (state->loop->abortWait(entry))
+      aborted += 1;
+  };
+  for (cancelState *scope = state->inner; scope != nullptr;
+       scope = scope->next)
+    aborted += cancel(scope);
+  return aborted;
+};
+
+void cancelState::release(cancelState *state) {
+  state->refs -= 1;
+  if (state->refs != 0)
+    return;
+
+  auto outer = state->outer;
+  if (outer != nullptr) {
+    if (state->prev != nullptr)
+      state->prev->next = state->next;
+    else
+      outer->inner = state->next;
+    if (state->next != nullptr)
+      state->next->prev = state->prev;
+  };
+  delete state;
+  if (outer != nullptr)
+    release(outer);
+};
+
+cancelSource::cancelSource() : state(nullptr) {
+  try {
+    state = new cancelState{
+        .bound = nullptr, .loop = nullptr, .refs = 1, .cancelled = false};
+  } catch (std::exception &e) {
+    state = nullptr;
+  };
+};
+
+cancelSource::~cancelSource() {
+  if (state == nullptr)
+    return;
+  // bound routines keep the state, cancel() can't reach them anymore.
+  cancelState::release(state);
+  state = nullptr;
+};
+
+size_t cancelSource::cancel() {
+  if (state == nullptr)
+    return 0;
+  return cancelState::cancel(state);
+};
+
+bool cancelled() {
+  auto state = buffio::fiber::queue->get()->cancel;
+  return state != nullptr && state->cancelled;
+};
+
+}; // namespace buffio
@@ -4,9 +4,14 @@
 
 namespace buffio {
 
+#define BUFFIO_WHEEL_MASK ((1 << BUFFIO_WHEEL_ORDER) - 1)
+
 int Clock::getNext() {
+  while (!clockTree.empty() && stale(clockTree.top()))
+    clockTree.pop();
+  int deadline = nextDeadline();
   if (clockTree.empty())
-    return -1;
+    return deadline;
 
   auto now = chrClock::now();
   auto next = clockTree.top().expires;
@@ -15,32 +20,140 @@ int Clock::getNext() {
     return 0;
   auto diff =
       std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+  if (deadline >= 0 && deadline < diff)
+    return deadline;
   return static_cast<int>(diff);
 };
 
+uint64_t Clock::tick() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             chrClock::now().time_since_epoch())
+      .count();
+};
+
+int Clock::nextDeadline() {
+  if (armed == 0)
+    return -1;
+  uint64_t now = tick();
+  if (wheelNext > now)
+    return (int)(wheelNext - now);
+  if (wheelTick < now)
+    return 0;
+
+  // the bound is used up, the first busy slot gives the next one. its
+  // headers may be due turns later, waking up early is harmless.
+  for (uint64_t at = now + 1; at <= now + BUFFIO_WHEEL_MASK + 1; at++) {
+    if (wheel[at & BUFFIO_WHEEL_MASK] != nullptr) {
+      wheelNext = at;
+      return (int)(at - now);
+    };
+  };
+  return -1;
+};
+
+void Clock::arm(buffioHeader *header, uint32_t ms) {
+  if (header->timerTick != 0)
+    disarm(header);
+
+  uint64_t now = tick();
+  // expiry only walks the slots after the last tick it handled.
+  if (armed == 0 || wheelTick > now)
+    wheelTick = now;
+
+  uint64_t at = now + (ms > 0 ? ms : 1);
+  buffioHeader *&slot = wheel[at & BUFFIO_WHEEL_MASK];
+  header->timerTick = at;
+  header->timerPrev = nullptr;
+  header->timerNext = slot;
+  if (slot != nullptr)
+    slot->timerPrev = header;
+  slot = header;
+
+  if (armed == 0 || at < wheelNext)
+    wheelNext = at;
+  armed += 1;
+};
+
+void Clock::disarm(buffioHeader *header) {
+  if (header->timerTick == 0)
+    return;
+
+  if (header->timerPrev != nullptr)
+    header->timerPrev->timerNext = header->timerNext;
+  else
+    wheel[header->timerTick & BUFFIO_WHEEL_MASK] = header->timerNext;
+  if (header->timerNext != nullptr)
+    header->timerNext->timerPrev = header->timerPrev;
+
+  header->timerTick = 0;
+  armed -= 1;
+};
+
+void Clock::expireDeadlines(buffioDeadlineFire fire, void *data) {
+  if (armed == 0)
+    return;
+  uint64_t now = tick();
+  if (now < wheelNext || now <= wheelTick)
+    return;
+
+  // a gap longer than a turn visits every slot once.
+  uint64_t steps = now - wheelTick;
+  if (steps > BUFFIO_WHEEL_MASK + 1)
+    steps = BUFFIO_WHEEL_MASK + 1;
+
+  for (uint64_t at = wheelTick + 1; at <= wheelTick + steps; at++) {
+    buffioHeader *header = wheel[at & BUFFIO_WHEEL_MASK];
+    while (header != nullptr) {
+      buffioHeader *next = header->timerNext;
+      if (header->timerTick <= now) {
+        disarm(header);
+        fire(header, data);
+      };
+      header = next;
+    };
+  };
+  wheelTick = now;
+};
+
+#undef BUFFIO_WHEEL_MASK
+
 void Clock::push(uint32_t delay, blockQueue *task) {
   assert(this != nullptr);
-  clockTree.push({std::chrono::milliseconds(delay) + chrClock::now(), task});
+  task->timer = ++sequence;
+  live += 1;
+  clockTree.push(
+      {std::chrono::milliseconds(delay) + chrClock::now(), task, task->timer});
 };
 
-void Clock::pushExpired(buffio::Queue<> &queue) {
-  if (clockTree.empty())
-    return;
+bool Clock::cancel(blockQueue *task) {
+  if (task->timer == 0)
+    return false;
+  task->timer = 0;
+  live -= 1;
+  // nothing armed anymore, don't keep stale nodes around.
+  if (live == 0)
+    clockTree = buffioClockTree();
+  return true;
+};
 
+void Clock::pushExpired(buffio::runQueue &queue) {
   auto now = chrClock::now();
-  auto next = clockTree.top().expires;
-  auto diff =
-      std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
 
-  while (diff <= 0) {
-    auto handle = clockTree.top().task;
-    queue.push(handle);
-    clockTree.pop();
-    if (clockTree.empty())
+  while (!clockTree.empty()) {
+    auto info = clockTree.top();
+    if (stale(info)) {
+      clockTree.pop();
+      continue;
+    };
+    if (std::chrono::duration_cast<std::chrono::milliseconds>(info.expires -
+                                                              now)
+            .count() > 0)
       break;
-    next = clockTree.top().expires;
-    diff = std::chrono::duration_cast<std::chrono::milliseconds>(next - now)
-               .count();
-  }
+
+    clockTree.pop();
+    info.task->timer = 0;
+    live -= 1;
+    queue.push(info.task);
+  };
 };
 }; // namespace buffio
@@ -19,10 +19,19 @@ void makeContainer::function(containerCallback callback, void *data,
  then->run = callback;
  tmp.run = [](void *data){
    auto *ptr = (buffio::functionInfo*)data;
-   ptr->run(nullptr);
+   ptr->run(ptr->data);
    buffio::fiber::queue->pop();
  };
- 
+ // nothing to release, a callback left queued at clean() is just dropped.
+ tmp.destroy = [](void *data) {};
+
+};
+
+void makeContainer::stackful(buffio::coro *task, buffio::container &tmp) {
+  static_assert(sizeof(task) <= CONTAINER_STORAGE_SIZE);
+  new (tmp.storage) buffio::coro *(task);
+  tmp.run = buffio::coro::run;
+  tmp.destroy = buffio::coro::destroy;
 };
 
 }; // namespace buffio
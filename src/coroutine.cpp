@@ -0,0 +1,322 @@
+#include "buffio/coroutine.hpp"
+#include "buffio/container.hpp"
+#include "buffio/enum.hpp"
+#include "buffio/fiber.hpp"
+#include "buffio/scheduler.hpp"
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+/*
+ * buffio_coro_switch(save, load): saves the callee saved registers on the
+ * current stack, stores the stack pointer in *save, loads load as the
+ * stack pointer and pops the registers of the other side. a fresh stack
+ * is built by prepare() to pop into buffio_coro_entry, which calls
+ * coro::start with the coro.
+ */
+extern "C" void buffio_coro_switch(void **save, void *load);
+extern "C" void buffio_coro_entry();
+
+#if defined(__x86_64__)
+asm(R"(
+  .pushsection .text
+  .globl buffio_coro_switch
+  .hidden buffio_coro_switch
+  .type buffio_coro_switch, @function
+  .p2align 4
+buffio_coro_switch:
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+  .size buffio_coro_switch, .-buffio_coro_switch
+
+  .globl buffio_coro_entry
+  .hidden buffio_coro_entry
+  .type buffio_coro_entry, @function
+buffio_coro_entry:
+  movq %r12, %rdi
+  callq *%r13
+  ud2
+  .size buffio_coro_entry, .-buffio_coro_entry
+  .popsection
+)");
+#elif defined(__aarch64__)
+asm(R"(
+  .pushsection .text
+  .globl buffio_coro_switch
+  .hidden buffio_coro_switch
+  .type buffio_coro_switch, %function
+  .p2align 4
+buffio_coro_switch:
+  sub sp, sp, #160
+  stp x19, x20, [sp, #0]
+  stp x21, x22, [sp, #16]
+  stp x23, x24, [sp, #32]
+  stp x25, x26, [sp, #48]
+  stp x27, x28, [sp, #64]
+  stp x29, x30, [sp, #80]
+  stp d8, d9, [sp, #96]
+  stp d10, d11, [sp, #112]
+  stp d12, d13, [sp, #128]
+  stp d14, d15, [sp, #144]
+  mov x2, sp
+  str x2, [x0]
+  mov sp, x1
+  ldp x19, x20, [sp, #0]
+  ldp x21, x22, [sp, #16]
+  ldp x23, x24, [sp, #32]
+  ldp x25, x26, [sp, #48]
+  ldp x27, x28, [sp, #64]
+  ldp x29, x30, [sp, #80]
+  ldp d8, d9, [sp, #96]
+  ldp d10, d11, [sp, #112]
+  ldp d12, d13, [sp, #128]
+  ldp d14, d15, [sp, #144]
+  add sp, sp, #160
+  ret
+  .size buffio_coro_switch, .-buffio_coro_switch
+
+  .globl buffio_coro_entry
+  .hidden buffio_coro_entry
+  .type buffio_coro_entry, %function
+buffio_coro_entry:
+  mov x0, x19
+  blr x20
+  brk #0
+  .size buffio_coro_entry, .-buffio_coro_entry
+  .popsection
+)");
+#else
+#error "buffio::coro has no context switch for this architecture"
+#endif
+
+namespace buffio {
+
+// fiber running on this thread, nullptr while the loop runs.
+static thread_local buffio::coro *running = nullptr;
+
+static size_t pageSize() {
+  static const size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+  return page;
+};
+
+/*
+ * lays out the registers popped by the first switch to the fiber, top is
+ * 16 bytes aligned.
+ */
+static void *prepare(char *top, void *self, void (*start)(buffio::coro *)) {
+#if defined(__x86_64__)
+  // the return address sits where a call would have put it, so start
+  // sees the stack alignment of a regular call.
+  auto slot = (uint64_t *)(top - 64);
+  slot[0] = (0x037FULL << 32) | 0x1F80; // default fpu control and mxcsr.
+  slot[1] = 0;                          // r15
+  slot[2] = 0;                          // r14
+  slot[3] = (uint64_t)start;            // r13
+  slot[4] = (uint64_t)self;             // r12
+  slot[5] = 0;                          // rbx
+  slot[6] = 0;                          // rbp
+  slot[7] = (uint64_t)buffio_coro_entry;
+  return slot;
+#elif defined(__aarch64__)
+  auto slot = (uint64_t *)(top - 160);
+  for (int i = 0; i < 20; i++)
+    slot[i] = 0;
+  slot[0] = (uint64_t)self;              // x19
+  slot[1] = (uint64_t)start;             // x20
+  slot[11] = (uint64_t)buffio_coro_entry; // x30
+  return slot;
+#endif
+};
+
+int coroStacks::map(size_t size, coro_wrapper &stack) {
+  size_t page = pageSize();
+  size = (size + page - 1) & ~(page - 1);
+  void *base = ::mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (base == MAP_FAILED)
+    return (int)buffioErrorCode::coroStack;
+  if (::mprotect(base, page, PROT_NONE) != 0) {
+    ::munmap(base, size + page);
+    return (int)buffioErrorCode::coroStack;
+  };
+  stack.stack = (char *)base;
+  stack.stack_size = size + page;
+  return 0;
+};
+
+void coroStacks::unmap(coro_wrapper &stack) {
+  ::munmap(stack.stack, stack.stack_size);
+  stack.stack = nullptr;
+  stack.stack_size = 0;
+};
+
+int coroStacks::get(size_t size, coro_wrapper &stack) {
+  if (size == BUFFIO_CORO_STACK && freeList != nullptr) {
+    stack = freeList->stack;
+    freeList = freeList->next;
+    counters.reuses += 1;
+    counters.pooled -= 1;
+    return 0;
+  };
+  int error = map(size, stack);
+  if (error == 0)
+    counters.maps += 1;
+  return error;
+};
+
+void coroStacks::put(coro_wrapper &stack) {
+  size_t page = pageSize();
+  if (stack.stack_size == BUFFIO_CORO_STACK + page &&
+      counters.pooled < BUFFIO_CORO_POOLED) {
+    // the node goes right above the guard page, the pages stay mapped.
+    auto node = (freeStack *)(stack.stack + page);
+    node->stack = stack;
+    node->next = freeList;
+    freeList = node;
+    counters.pooled += 1;
+    return;
+  };
+  unmap(stack);
+  counters.unmaps += 1;
+};
+
+coroStacks::~coroStacks() {
+  while (freeList != nullptr) {
+    coro_wrapper stack = freeList->stack;
+    freeList = freeList->next;
+    unmap(stack);
+  };
+  counters.pooled = 0;
+};
+
+buffio::coro *coro::make(entryRoutine entry, void *data, size_t stackSize) {
+  auto pool = buffio::fiber::stacks;
+  coro_wrapper stack;
+  int error = pool != nullptr ? pool->get(stackSize, stack)
+                              : coroStacks::map(stackSize, stack);
+  if (error != 0)
+    return nullptr;
+
+  // the coro itself takes the top of its stack.
+  char *top = stack.stack + stack.stack_size;
+  top -= (sizeof(coro) + 63) & ~(size_t)63;
+  auto self = new (top) coro();
+  self->loopSp = nullptr;
+  self->entry = entry;
+  self->data = data;
+  self->pool = pool;
+  self->stack = stack;
+  self->finished = false;
+#if defined(__SANITIZE_ADDRESS__)
+  self->fakeStack = nullptr;
+  self->loopBottom = nullptr;
+  self->loopSize = 0;
+#endif
+  self->sp = prepare(top, self, coro::start);
+  return self;
+};
+
+void coro::start(buffio::coro *self) {
+#if defined(__SANITIZE_ADDRESS__)
+  __sanitizer_finish_switch_fiber(nullptr, &self->loopBottom,
+                                  &self->loopSize);
+#endif
+  self->entry(self->data);
+  self->finished = true;
+  self->switchOut();
+  __builtin_unreachable();
+};
+
+void coro::switchOut() {
+#if defined(__SANITIZE_ADDRESS__)
+  // a finished fiber never comes back, its fake stack can go.
+  __sanitizer_start_switch_fiber(finished ? nullptr : &fakeStack, loopBottom,
+                                 loopSize);
+#endif
+  buffio_coro_switch(&sp, loopSp);
+#if defined(__SANITIZE_ADDRESS__)
+  __sanitizer_finish_switch_fiber(fakeStack, &loopBottom, &loopSize);
+#endif
+};
+
+void coro::release() {
+  // the coro lives on the stack released.
+  auto owner = pool;
+  coro_wrapper mapping = stack;
+  this->~coro();
+  if (owner != nullptr)
+    owner->put(mapping);
+  else
+    coroStacks::unmap(mapping);
+};
+
+void coro::run(void *data) {
+  auto self = *(buffio::coro **)data;
+  running = self;
+#if defined(__SANITIZE_ADDRESS__)
+  void *fake = nullptr;
+  size_t page = pageSize();
+  __sanitizer_start_switch_fiber(&fake, self->stack.stack + page,
+                                 self->stack.stack_size - page);
+#endif
+  buffio_coro_switch(&self->loopSp, self->sp);
+#if defined(__SANITIZE_ADDRESS__)
+  __sanitizer_finish_switch_fiber(fake, nullptr, nullptr);
+#endif
+  running = nullptr;
+
+  // done, its entry is still the head of the run queue.
+  if (self->finished) {
+    buffio::fiber::queue->pop();
+    self->release();
+  };
+};
+
+void coro::destroy(void *data) { (*(buffio::coro **)data)->release(); };
+
+bool coro::inside() { return running != nullptr; };
+
+void coro::wait(buffioHeader *header) {
+  assert(running != nullptr);
+  if (buffio::fiber::loop->parkOn(header))
+    running->switchOut();
+};
+
+void coro::sleep(size_t ms) {
+  assert(running != nullptr);
+  if (buffio::fiber::loop->parkFor(ms))
+    running->switchOut();
+};
+
+void coro::yield() {
+  assert(running != nullptr);
+  // still at the head of the run queue, the loop rotates it.
+  running->switchOut();
+};
+
+}; // namespace buffio
@@ -3,6 +3,7 @@
 #include "buffio/common.hpp"
 #include "buffio/enum.hpp"
 #include "buffio/fiber.hpp"
+#include "buffio/scheduler.hpp"
 
 #include <cerrno>
 #include <cstring>
@@ -236,9 +237,31 @@ namespace buffio {
 
 Fd::~Fd() { release(); }
 
+/*
+ * io_uring backend: a prepared sqe counts as pending request until its
+ * completion is reaped by the scheduler, on a full ring the header is
+ * given back as done with EBUSY so the routine is not suspended forever.
+ */
+static inline buffioHeader *uringPending(buffioHeader &header, int error) {
+  if (error != 0) {
+    header.isFresh = false;
+    header.opError = EBUSY;
+    return nullptr;
+  };
+  buffio::fiber::state->pendingReq.fetch_add(1, std::memory_order_acq_rel);
+  return &header;
+};
+
 buffioHeader *Fd::waitReadReady() {
   if (readHeader.isFresh || rwmask & BUFFIO_READ_READY)
     return nullptr;
+  readHeader.abortCode = 0;
+
+  if (auto ring = buffio::fiber::ring) {
+    readHeader.action = buffio::action::uringPoll;
+    readHeader.isFresh = true;
+    return uringPending(readHeader, ring->pollAdd(&readHeader, EPOLLIN));
+  };
 
   readHeader.action = buffio::action::propBack;
   readHeader.aux = BUFFIO_READ_READY;
@@ -250,6 +273,13 @@ buffioHeader *Fd::waitReadReady() {
 buffioHeader *Fd::waitWriteReady() {
   if (writeHeader.isFresh || rwmask & BUFFIO_WRITE_READY)
     return nullptr;
+  writeHeader.abortCode = 0;
+
+  if (auto ring = buffio::fiber::ring) {
+    writeHeader.action = buffio::action::uringPoll;
+    writeHeader.isFresh = true;
+    return uringPending(writeHeader, ring->pollAdd(&writeHeader, EPOLLOUT));
+  };
 
   writeHeader.action = buffio::action::propBack;
   writeHeader.aux = BUFFIO_WRITE_READY;
@@ -275,6 +305,7 @@ inline void make_socked_header(buffioHeader &header, sockaddr *addr,
   header.data.socketaddr = addr;
   header.len.socklen = len;
   header.isFresh = true;
+  header.abortCode = 0;
   header.opError = 0;
   header.action = act;
 };
@@ -282,6 +313,11 @@ buffioHeader *Fd::waitAccept(struct sockaddr *addr, socklen_t len) {
   if (readHeader.isFresh)
     return nullptr;
 
+  if (auto ring = buffio::fiber::ring) {
+    make_socked_header(readHeader, addr, len, buffio::action::uringAccept);
+    return uringPending(readHeader, ring->accept(&readHeader));
+  };
+
   if (!(rwmask & BUFFIO_FD_ACCEPT_READY)) {
     buffio::fiber::poller->pollMod(localfd.fd[0], this, EPOLLIN | EPOLLET);
     rwmask |= BUFFIO_FD_ACCEPT_READY;
@@ -293,7 +329,7 @@ buffioHeader *Fd::waitAccept(struct sockaddr *addr, socklen_t len) {
     buffio::fiber::requestBatch->pushHead(&readHeader);
     return &readHeader;
   }
-  buffio::fiber::pendingReq.fetch_add(1, std::memory_order_acq_rel);
+  buffio::fiber::state->pendingReq.fetch_add(1, std::memory_order_acq_rel);
   pendingReadReq = &readHeader;
   return &readHeader;
 };
@@ -303,6 +339,12 @@ buffioHeader *Fd::waitConnect(struct sockaddr *addr, socklen_t socklen) {
   if (writeHeader.isFresh)
     return nullptr;
 
+  if (auto ring = buffio::fiber::ring) {
+    make_socked_header(writeHeader, addr, socklen,
+                       buffio::action::uringConnect);
+    return uringPending(writeHeader, ring->connect(&writeHeader));
+  };
+
   if (this->connect(addr, socklen) != -1)
     return nullptr;
 
@@ -322,6 +364,8 @@ inline void make_read_write_header(buffioHeader &header, char *buffer,
   header.data.buffer = buffer;
   header.len.socklen = len;
   header.isFresh = true;
+  header.onWorker = false;
+  header.abortCode = 0;
 };
 buffioHeader *Fd::waitRead(char *buffer, size_t len) {
 
@@ -334,11 +378,21 @@ buffioHeader *Fd::waitRead(char *buffer, size_t len) {
   make_read_write_header(readHeader, buffer, len);
 
   if (fdFamily == buffioFdFamily::file) {
+    if (rwmask & BUFFIO_FD_URING && buffio::fiber::ring != nullptr) {
+      readHeader.action = buffio::action::uringReadWrite;
+      return uringPending(readHeader, buffio::fiber::ring->read(
+                                          &readHeader, -1, fileSlot));
+    };
     readHeader.action = buffio::action::readFile;
     buffio::fiber::threadRequestBatch->push(&readHeader); 
     return &readHeader;
   };
 
+  if (auto ring = buffio::fiber::ring) {
+    readHeader.action = buffio::action::uringReadWrite;
+    return uringPending(readHeader, ring->read(&readHeader));
+  };
+
   readHeader.action = buffio::action::read;
   if (rwmask & BUFFIO_READ_READY) {
     buffio::fiber::requestBatch->push(&readHeader);
@@ -346,7 +400,7 @@ buffioHeader *Fd::waitRead(char *buffer, size_t len) {
   };
 
   pendingReadReq = &readHeader;
-  buffio::fiber::pendingReq.fetch_add(1, std::memory_order_acq_rel);
+  buffio::fiber::state->pendingReq.fetch_add(1, std::memory_order_acq_rel);
   return &readHeader;
 };
 
@@ -358,16 +412,52 @@ buffioHeader *Fd::waitWrite(char *buffer, size_t len) {
   make_read_write_header(writeHeader, buffer, len);
 
   if (fdFamily == buffioFdFamily::file) {
+    if (rwmask & BUFFIO_FD_URING && buffio::fiber::ring != nullptr) {
+      writeHeader.action = buffio::action::uringReadWrite;
+      return uringPending(writeHeader, buffio::fiber::ring->write(
+                                           &writeHeader, -1, fileSlot));
+    };
     writeHeader.action = buffio::action::writeFile;
     buffio::fiber::threadRequestBatch->push(&writeHeader);
     return &writeHeader;
   };
 
+  if (auto ring = buffio::fiber::ring) {
+    writeHeader.action = buffio::action::uringReadWrite;
+    return uringPending(writeHeader, ring->write(&writeHeader));
+  };
+
   writeHeader.action = buffio::action::write;
   buffio::fiber::requestBatch->push(&writeHeader);
   return &writeHeader;
 };
 
+static inline buffioHeader *withDeadline(buffioHeader *header, uint32_t ms) {
+  if (header != nullptr)
+    buffio::fiber::timerClock->arm(header, ms);
+  return header;
+};
+
+buffioHeader *Fd::waitRead(char *buffer, size_t len,
+                           buffio::clockSpec::timeout timeout) {
+  return withDeadline(waitRead(buffer, len), timeout.ms);
+};
+
+buffioHeader *Fd::waitWrite(char *buffer, size_t len,
+                            buffio::clockSpec::timeout timeout) {
+  return withDeadline(waitWrite(buffer, len), timeout.ms);
+};
+
+buffioHeader *Fd::waitAccept(struct sockaddr *addr, socklen_t len,
+                             buffio::clockSpec::timeout timeout) {
+  return withDeadline(waitAccept(addr, len), timeout.ms);
+};
+
+buffioHeader *Fd::waitConnect(struct sockaddr *addr, socklen_t socklen,
+                              buffio::clockSpec::timeout timeout) {
+  return withDeadline(waitConnect(addr, socklen), timeout.ms);
+};
+
 buffioRoutineStatus Fd::asyncRead(char *buffer, size_t len, onAsyncReads then) {
 
   if (readHeader.isFresh)
@@ -378,11 +468,23 @@ buffioRoutineStatus Fd::asyncRead(char *buffer, size_t len, onAsyncReads then) {
   readHeader.entry = buffio::fiber::queue->getEntry();
 
   if (fdFamily == buffioFdFamily::file) {
+    if (rwmask & BUFFIO_FD_URING && buffio::fiber::ring != nullptr) {
+      readHeader.action = buffio::action::uringAsyncRead;
+      uringPending(readHeader,
+                   buffio::fiber::ring->read(&readHeader, -1, fileSlot));
+      return buffioRoutineStatus::none;
+    };
     readHeader.action = buffio::action::asyncReadFile;
     buffio::fiber::threadRequestBatch->push(&readHeader);
     return buffioRoutineStatus::none;
   };
 
+  if (auto ring = buffio::fiber::ring) {
+    readHeader.action = buffio::action::uringAsyncRead;
+    uringPending(readHeader, ring->read(&readHeader));
+    return buffioRoutineStatus::none;
+  };
+
   readHeader.action = buffio::action::asyncRead;
 
   if (rwmask & BUFFIO_READ_READY) {
@@ -390,7 +492,7 @@ buffioRoutineStatus Fd::asyncRead(char *buffer, size_t len, onAsyncReads then) {
     return buffioRoutineStatus::none;
   }
 
-  buffio::fiber::pendingReq.fetch_add(1, std::memory_order_acq_rel);
+  buffio::fiber::state->pendingReq.fetch_add(1, std::memory_order_acq_rel);
   pendingReadReq = &readHeader;
   return buffioRoutineStatus::none;
 };
@@ -406,11 +508,23 @@ buffioRoutineStatus Fd::asyncWrite(char *buffer, size_t len,
   writeHeader.entry = buffio::fiber::queue->getEntry();
 
   if (fdFamily == buffioFdFamily::file) {
+    if (rwmask & BUFFIO_FD_URING && buffio::fiber::ring != nullptr) {
+      writeHeader.action = buffio::action::uringAsyncWrite;
+      uringPending(writeHeader,
+                   buffio::fiber::ring->write(&writeHeader, -1, fileSlot));
+      return buffioRoutineStatus::none;
+    };
     writeHeader.action = buffio::action::asyncWriteFile;
     buffio::fiber::threadRequestBatch->push(&writeHeader);
     return buffioRoutineStatus::none;
   };
 
+  if (auto ring = buffio::fiber::ring) {
+    writeHeader.action = buffio::action::uringAsyncWrite;
+    uringPending(writeHeader, ring->write(&writeHeader));
+    return buffioRoutineStatus::none;
+  };
+
   writeHeader.action = buffio::action::asyncWrite;
   buffio::fiber::requestBatch->push(&writeHeader);
   return buffioRoutineStatus::none;
@@ -427,6 +541,27 @@ void Fd::release() {
   auto family = this->fdFamily;
   this->fdFamily = buffioFdFamily::none;
 
+  // the timer wheel links our headers until their deadline is disarmed.
+  for (buffioHeader *header : {&readHeader, &writeHeader, &reserveHeader}) {
+    if (header->timerTick != 0 && buffio::fiber::timerClock != nullptr)
+      buffio::fiber::timerClock->disarm(header);
+  };
+
+  // the ring still points to our headers, wait for them to be cancelled.
+  if (rwmask & BUFFIO_FD_URING && buffio::fiber::ring != nullptr) {
+    for (buffioHeader *header : {&readHeader, &writeHeader, &reserveHeader}) {
+      if (!header->isFresh)
+        continue;
+      header->isFresh = false;
+      buffio::fiber::ring->cancel(header);
+      buffio::fiber::state->pendingReq.fetch_add(-1,
+                                                 std::memory_order_acq_rel);
+    };
+    buffio::fiber::ring->unregisterFile(fileSlot);
+    fileSlot = -1;
+    rwmask &= ~BUFFIO_FD_URING;
+  };
+
   switch (family) {
   case buffioFdFamily::none:
     break;
@@ -464,12 +599,24 @@ void Fd::release() {
 };
 
 void Fd::mountSocket(char *address, int socketfd, int portnumber) noexcept {
-  buffio::fiber::poller->pollOp(socketfd, this);
+  // the ring does the readiness tracking itself, no epoll registration.
+  if (buffio::fiber::ring != nullptr)
+    rwmask |= BUFFIO_FD_URING;
+  else
+    buffio::fiber::poller->pollOp(socketfd, this);
   buffio::fiber::FdCount.fetch_add(1, std::memory_order_acq_rel);
 
   localfd.sock.socketFd = socketfd;
   localfd.sock.portnumber = portnumber;
 
+  // busy-poll mode of the loop, best effort (may need CAP_NET_ADMIN).
+  if (buffio::fiber::loop != nullptr &&
+      buffio::fiber::loop->busyStats().sockBusyPoll > 0) {
+    int usec = buffio::fiber::loop->busyStats().sockBusyPoll;
+    (void)::setsockopt(socketfd, SOL_SOCKET, SO_BUSY_POLL, &usec,
+                       sizeof(usec));
+  };
+
   readHeader.iFd = writeHeader.iFd = reserveHeader.iFd = socketfd;
 
   writeHeader.isFresh = readHeader.isFresh = false;
@@ -488,9 +635,14 @@ void Fd::mountPipe(int read, int write) noexcept {
   writeHeader.isFresh = readHeader.isFresh = false;
 
   buffio::fiber::FdCount.fetch_add(2, std::memory_order_acq_rel);
+  this->rwmask |= BUFFIO_FD_POLLED;
+
+  if (buffio::fiber::ring != nullptr) {
+    rwmask |= BUFFIO_FD_URING;
+    return;
+  };
   buffio::fiber::poller->pollOp(read, this, EPOLLIN | EPOLLET);
   buffio::fiber::poller->pollOp(write, this, EPOLLOUT | EPOLLET);
-  this->rwmask |= BUFFIO_FD_POLLED;
 };
 
 void Fd::mountFile(int fd) {
@@ -498,6 +650,13 @@ void Fd::mountFile(int fd) {
   localfd.fileFd = fd;
   readHeader.iFd = writeHeader.iFd = reserveHeader.iFd = fd;
   readHeader.isFresh = writeHeader.isFresh = false;
+
+  // read/write at the file position (offset -1) through the ring, an
+  // unregistered fd (table full) still goes through the ring, by number.
+  if (buffio::fiber::ring != nullptr && buffio::fiber::ring->files()) {
+    fileSlot = buffio::fiber::ring->registerFile(fd);
+    rwmask |= BUFFIO_FD_URING;
+  };
 };
 void Fd::mountEventFd(int fd) {
 
@@ -513,7 +672,7 @@ void Fd::takeEventReadAction() {
 
   if (pendingReadReq == nullptr) return;
   
-  buffio::fiber::pendingReq.fetch_add(-1, std::memory_order_acq_rel);
+  buffio::fiber::state->pendingReq.fetch_add(-1, std::memory_order_acq_rel);
   buffio::fiber::requestBatch->push(pendingReadReq);
   pendingReadReq = nullptr;
 };
@@ -522,7 +681,7 @@ void Fd::takeEventWriteAction() {
   rwmask |= BUFFIO_WRITE_READY;
   if (pendingWriteReq == nullptr) return; 
 
-  buffio::fiber::pendingReq.fetch_add(-1, std::memory_order_acq_rel);
+  buffio::fiber::state->pendingReq.fetch_add(-1, std::memory_order_acq_rel);
   buffio::fiber::requestBatch->push(pendingWriteReq);
   pendingWriteReq = nullptr;
 };
@@ -5,18 +5,21 @@ namespace buffio {
 namespace fiber {
 
 
-buffio::Queue<buffioHeader, void *, buffioQueueNoMem> *requestBatch = nullptr;
-buffio::Queue<buffioHeader, void *, buffioQueueNoMem> *threadRequestBatch = nullptr;
-buffio::Queue<> *queue = nullptr;
-buffio::Clock *timerClock = nullptr;
-buffio::sockBroker *poller = nullptr;
-std::atomic<size_t> workerCount = 0;
-std::atomic<ssize_t> abort = 0;
+BUFFIO_FIBER_TLS buffio::Queue<buffioHeader, void *, buffioQueueNoMem>
+    *requestBatch = nullptr;
+BUFFIO_FIBER_TLS buffio::Queue<buffioHeader, void *, buffioQueueNoMem>
+    *threadRequestBatch = nullptr;
+BUFFIO_FIBER_TLS buffio::runQueue *queue = nullptr;
+BUFFIO_FIBER_TLS buffio::Clock *timerClock = nullptr;
+BUFFIO_FIBER_TLS buffio::sockBroker *poller = nullptr;
+BUFFIO_FIBER_TLS buffio::scheduler *loop = nullptr;
+BUFFIO_FIBER_TLS buffio::uring *ring = nullptr;
+BUFFIO_FIBER_TLS loopState *state = nullptr;
+BUFFIO_FIBER_TLS buffio::framePool *frames = nullptr;
+BUFFIO_FIBER_TLS buffio::coroStacks *stacks = nullptr;
+BUFFIO_FIBER_TLS buffio::Memory<buffioHeader> *headers = nullptr;
+BUFFIO_FIBER_TLS buffio::computePool *compute = nullptr;
 std::atomic<ssize_t> FdCount = 0;
-std::atomic<ssize_t> pendingReq = 0;
-std::atomic<ssize_t> sleepingThread = 0;
-std::atomic<ssize_t> queuedCompleted = 0;
-std::atomic <bool> loopWakedUp = false;
 
 }; // namespace fiber
 }; // namespace buffio
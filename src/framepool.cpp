@@ -0,0 +1,121 @@
+#include "buffio/framepool.hpp"
+#include "buffio/fiber.hpp"
+#include <new>
+
+namespace buffio {
+
+static inline size_t slotSize(size_t sizeClass) {
+  return ((size_t)1 << (BUFFIO_FRAME_MIN_ORDER + sizeClass)) + 16;
+};
+
+framePool::framePool() : pages(nullptr) {
+  static_assert(sizeof(frameHead) == 16, "frame head must keep alignment");
+  for (size_t i = 0; i < BUFFIO_FRAME_CLASSES; i++) {
+    freeList[i] = nullptr;
+    remote[i].store(nullptr, std::memory_order_relaxed);
+  };
+};
+
+framePool::~framePool() {
+  while (pages != nullptr) {
+    frameNode *next = pages->next;
+    ::operator delete(pages);
+    pages = next;
+  };
+};
+
+int framePool::makePage(size_t sizeClass) {
+  size_t slot = slotSize(sizeClass);
+  size_t count = (BUFFIO_FRAME_PAGE - 16) / slot;
+  if (count < 4)
+    count = 4;
+
+  char *page = nullptr;
+  try {
+    page = (char *)::operator new(16 + count * slot);
+  } catch (std::exception &e) {
+    return -1;
+  };
+
+  // the first 16 bytes link the page, the slots follow.
+  ((frameNode *)page)->next = pages;
+  pages = (frameNode *)page;
+  for (size_t i = 0; i < count; i++)
+    push(sizeClass, (frameNode *)(page + 16 + i * slot));
+  counters.pages += 1;
+  return 0;
+};
+
+void framePool::push(size_t sizeClass, frameNode *node) {
+  node->next = freeList[sizeClass];
+  freeList[sizeClass] = node;
+};
+
+void *framePool::pop(size_t sizeClass) {
+  if (freeList[sizeClass] == nullptr) {
+    freeList[sizeClass] =
+        remote[sizeClass].exchange(nullptr, std::memory_order_acquire);
+    for (frameNode *node = freeList[sizeClass]; node != nullptr;
+         node = node->next)
+      counters.remote += 1;
+    if (freeList[sizeClass] == nullptr && makePage(sizeClass) != 0)
+      return nullptr;
+  };
+  frameNode *node = freeList[sizeClass];
+  freeList[sizeClass] = node->next;
+  return node;
+};
+
+void *framePool::allocate(size_t size) {
+  framePool *pool = buffio::fiber::frames;
+  size_t sizeClass = 0;
+  while (sizeClass < BUFFIO_FRAME_CLASSES &&
+         ((size_t)1 << (BUFFIO_FRAME_MIN_ORDER + sizeClass)) < size)
+    sizeClass += 1;
+
+  frameHead *head = nullptr;
+  if (pool != nullptr) {
+    if (size > pool->counters.largest)
+      pool->counters.largest = size;
+    if (sizeClass < BUFFIO_FRAME_CLASSES)
+      head = (frameHead *)pool->pop(sizeClass);
+  };
+
+  if (head == nullptr) {
+    // throws std::bad_alloc like the default frame allocation.
+    head = (frameHead *)::operator new(size + sizeof(frameHead));
+    head->pool = nullptr;
+    if (pool != nullptr)
+      pool->counters.heap += 1;
+  } else {
+    head->pool = pool;
+    head->sizeClass = sizeClass;
+    pool->counters.allocs[sizeClass] += 1;
+  };
+  return head + 1;
+};
+
+void framePool::release(void *frame) {
+  frameHead *head = (frameHead *)frame - 1;
+  framePool *pool = head->pool;
+  size_t sizeClass = head->sizeClass;
+
+  if (pool == nullptr) {
+    ::operator delete(head);
+    return;
+  };
+
+  frameNode *node = (frameNode *)head;
+  if (pool == buffio::fiber::frames) {
+    pool->push(sizeClass, node);
+    return;
+  };
+
+  // another thread owns the pool, hand the frame over.
+  node->next = pool->remote[sizeClass].load(std::memory_order_relaxed);
+  while (!pool->remote[sizeClass].compare_exchange_weak(
+      node->next, node, std::memory_order_release, std::memory_order_relaxed))
+    ;
+};
+
+}; // namespace buffio
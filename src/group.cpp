@@ -0,0 +1,101 @@
+#include "buffio/cancel.hpp"
+#include "buffio/group.hpp"
+
+namespace buffio {
+
+void joinState::finish(joinState *state, uint32_t slot) {
+  state->done += 1;
+  if (state->first < 0) {
+    state->first = slot;
+    // whenAny, the children still running lost.
+    if (state->scope != nullptr)
+      buffio::cancelState::cancel(state->scope);
+  };
+
+  if (state->parent != nullptr && state->done >= state->need) {
+    buffio::fiber::queue->push(state->parent);
+    state->parent = nullptr;
+  };
+
+  release(state);
+};
+
+void joinState::release(joinState *state) {
+  state->refs -= 1;
+  if (state->refs != 0)
+    return;
+  if (state->scope != nullptr)
+    buffio::cancelState::release(state->scope);
+  delete state;
+};
+
+taskGroup::~taskGroup() {
+  if (state == nullptr)
+    return;
+  // running children keep the state, nobody is resumed by them anymore.
+  state->parent = nullptr;
+  joinState::release(state);
+  state = nullptr;
+};
+
+int taskGroup::open() {
+  if (state != nullptr)
+    return 0;
+  try {
+    state = new joinState{.parent = nullptr,
+                          .refs = 1,
+                          .spawned = 0,
+                          .done = 0,
+                          .need = 0,
+                          .first = -1,
+                          .scope = nullptr};
+  } catch (std::exception &e) {
+    return (int)buffioErrorCode::groupState;
+  };
+  return 0;
+};
+
+int taskGroup::race() {
+  int error = open();
+  if (error == 0 && state->scope == nullptr) {
+    auto current = buffio::fiber::queue->get();
+    state->scope = buffio::cancelState::nest(current->cancel);
+    if (state->scope == nullptr)
+      error = (int)buffioErrorCode::groupState;
+  };
+  if (error != 0 && failed == 0)
+    failed = error;
+  return error;
+};
+
+ssize_t taskGroup::spawn(buffio::promise task) {
+  int error = open();
+  blockQueue *entry = nullptr;
+  if (error == 0 && (entry = buffio::fiber::queue->getEntry()) == nullptr)
+    error = (int)buffioErrorCode::groupState;
+
+  // never started, nobody else owns the frame.
+  if (error != 0) {
+    task.get().destroy();
+    if (failed == 0)
+      failed = error;
+    return error;
+  };
+
+  auto current = buffio::fiber::queue->get();
+  buffio::makeContainer::routine(task, entry->task);
+  entry->priority = current->priority;
+  entry->deadline = current->deadline;
+  if (state->scope != nullptr)
+    buffio::cancelState::bind(state->scope, entry);
+  else if (current->cancel != nullptr)
+    buffio::cancelState::bind(current->cancel, entry);
+  entry->join = state;
+  entry->joinSlot = (uint32_t)state->spawned;
+  state->spawned += 1;
+  state->refs += 1;
+  buffio::fiber::queue->push(entry);
+  return entry->joinSlot;
+};
+
+}; // namespace buffio
@@ -1,4 +1,5 @@
 #include "buffio/lfcore.hpp"
+#include <thread>
 
 namespace buffio {
 namespace lfCore {
@@ -33,16 +34,18 @@ bool lfenqueue(struct queueconf *which, size_t _order, size_t index) {
                                // want, distributing across cachelines.
     entry = which->data[tidx].load(
         std::memory_order_acquire); // loading the entry form that index.
+
+  retry:
+    // recomputed on every retry, a failed cas reloads the entry.
     entcycle =
         entry | ((size << 1) -
                  1); // extracting the cycle of entry. here we mask out the
                      // index bit's to '1', leaving only cycle bits valid
     // entry == ecycle when the entry is free and there is no index in there.
-
-  retry:
-    if (buffio_cmp(entcycle, <, tailcycle) && ((entry == entcycle)) ||
-        ((entry == (entcycle ^ size)) &&
-         buffio_cmp(which->head.load(std::memory_order_acquire), <=, tail))) {
+    if (buffio_cmp(entcycle, <, tailcycle) &&
+        ((entry == entcycle) ||
+         ((entry == (entcycle ^ size)) &&
+          buffio_cmp(which->head.load(std::memory_order_acquire), <=, tail)))) {
       if (!which->data[tidx].compare_exchange_weak(entry, (tailcycle ^ index),
                                                    std::memory_order_acq_rel))
         goto retry;
@@ -68,6 +71,7 @@ size_t lfdequeue(struct queueconf *which, size_t _order) {
     head = which->head.fetch_add(1, std::memory_order_acq_rel);
     tidx = cache_remap2(head, _order, size);
     headcycle = (head << 1) | mask;
+    attempt = 0;
 
   again:
     entry = which->data[tidx].load(std::memory_order_acquire);
@@ -83,8 +87,13 @@ size_t lfdequeue(struct queueconf *which, size_t _order) {
         if (entry == entnew)
           break;
       } else {
-        if (++attempt <= 5000)
+        if (++attempt <= 5000) {
+          // the enqueuer owning the slot may be preempted, give it the cpu
+          // now and then instead of burning the whole time slice.
+          if ((attempt & 63) == 0)
+            std::this_thread::yield();
           goto again;
+        };
         entnew = headcycle ^ ((~entry) & size);
       };
     } while (buffio_cmp(entcycle, <, headcycle) &&
@@ -94,7 +103,9 @@ size_t lfdequeue(struct queueconf *which, size_t _order) {
     tail = which->tail.load(std::memory_order_acquire);
     if (tail <= (head + 1)) {
       lfCore::catchup(which, tail, head + 1);
-      which->threshold.store(-1, std::memory_order_release);
+      // decrement as in the paper, a store of -1 could overwrite the reset
+      // of a concurrent enqueue and strand its entry.
+      which->threshold.fetch_add(-1, std::memory_order_acq_rel);
       return BUFFIO_EMPTY;
     }
 
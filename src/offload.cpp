@@ -0,0 +1,156 @@
+#include "buffio/offload.hpp"
+#include "buffio/enum.hpp"
+#include "buffio/scheduler.hpp"
+#include <new>
+
+namespace buffio {
+
+int computePool::start(int num, size_t order, int node) {
+  if (running())
+    return (int)buffioErrorCode::occupied;
+  if (num <= 0)
+    return (int)buffioErrorCode::workerNum;
+
+  try {
+    workers = new worker[num];
+  } catch (std::exception &e) {
+    return (int)buffioErrorCode::computePool;
+  };
+  for (int i = 0; i < num; i++) {
+    auto self = &workers[i];
+    self->pool = this;
+    self->id = (size_t)i;
+    self->sleeping.store(false, std::memory_order_relaxed);
+    self->jobs.store(0, std::memory_order_relaxed);
+    self->stolen.store(0, std::memory_order_relaxed);
+    if (self->deque.init(order) != 0 || ::sem_init(&self->signal, 0, 0) != 0) {
+      delete[] workers;
+      workers = nullptr;
+      return (int)buffioErrorCode::computePool;
+    };
+  };
+  stopping.store(false, std::memory_order_release);
+  workerNum = (size_t)num;
+
+  for (int i = 0; i < num; i++) {
+    if (threads.run(nullptr, computePool::workerMain, &workers[i],
+                    buffio::thread::SD, {.cpu = -1, .node = node}) != 0) {
+      stop();
+      return (int)buffioErrorCode::threadRun;
+    };
+  };
+  return 0;
+};
+
+void computePool::stop() {
+  if (!running())
+    return;
+  stopping.store(true, std::memory_order_seq_cst);
+  for (size_t i = 0; i < workerNum; i++)
+    ::sem_post(&workers[i].signal);
+  threads.join();
+  threads.free();
+
+  for (size_t i = 0; i < workerNum; i++)
+    ::sem_destroy(&workers[i].signal);
+  delete[] workers;
+  workers = nullptr;
+  workerNum = 0;
+  next = 0;
+};
+
+bool computePool::submit(offloadJob *job) {
+  for (size_t i = 0; i < workerNum; i++) {
+    auto target = &workers[(next + i) % workerNum];
+    if (!target->deque.push(job))
+      continue;
+    next = (next + i + 1) % workerNum;
+    wake(target);
+    return true;
+  };
+  return false;
+};
+
+/*
+ * orders the push before the sleeping flags are read, pairs with the flag
+ * store and pending() recheck of a worker going to sleep.
+ */
+void computePool::wake(worker *target) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (target->sleeping.exchange(false, std::memory_order_seq_cst)) {
+    ::sem_post(&target->signal);
+    return;
+  };
+  // the owner of the deque is busy, an idle peer steals the job.
+  for (size_t i = 1; i < workerNum; i++) {
+    auto peer = &workers[(target->id + i) % workerNum];
+    if (peer->sleeping.load(std::memory_order_relaxed) &&
+        peer->sleeping.exchange(false, std::memory_order_seq_cst)) {
+      ::sem_post(&peer->signal);
+      return;
+    };
+  };
+};
+
+offloadJob *computePool::take(worker *self) {
+  // own deque first, in arrival order.
+  offloadJob *job = self->deque.steal(nullptr);
+  if (job != nullptr)
+    return job;
+
+  for (size_t i = 1; i < workerNum; i++) {
+    auto peer = &workers[(self->id + i) % workerNum];
+    if (peer->deque.empty())
+      continue;
+    job = peer->deque.steal(nullptr);
+    if (job != nullptr) {
+      self->stolen.fetch_add(1, std::memory_order_relaxed);
+      return job;
+    };
+  };
+  return nullptr;
+};
+
+bool computePool::pending() const {
+  for (size_t i = 0; i < workerNum; i++)
+    if (!workers[i].deque.empty())
+      return true;
+  return false;
+};
+
+int computePool::workerMain(void *data) {
+  auto self = (worker *)data;
+  auto pool = self->pool;
+
+  while (!pool->stopping.load(std::memory_order_acquire)) {
+    offloadJob *job = pool->take(self);
+    if (job != nullptr) {
+      job->invoke(job);
+      self->jobs.fetch_add(1, std::memory_order_relaxed);
+      // the job lives in the frame of the routine, gone once it resumes.
+      job->wait.resume();
+      continue;
+    };
+
+    self->sleeping.store(true, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // a job pushed before the flag was visible is picked up here.
+    if (pool->pending()) {
+      self->sleeping.store(false, std::memory_order_relaxed);
+      continue;
+    };
+    ::sem_wait(&self->signal);
+  };
+  return 0;
+};
+
+buffio::computeStats computePool::stats() const {
+  buffio::computeStats counters;
+  for (size_t i = 0; i < workerNum; i++) {
+    counters.jobs += workers[i].jobs.load(std::memory_order_relaxed);
+    counters.stolen += workers[i].stolen.load(std::memory_order_relaxed);
+  };
+  return counters;
+};
+
+}; // namespace buffio
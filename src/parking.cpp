@@ -0,0 +1,44 @@
+#include "buffio/parking.hpp"
+#include <cerrno>
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace buffio {
+
+bool parkingLot::park(uint32_t ticket, const struct timespec *deadline) {
+  bool woken = true;
+  for (;;) {
+    long error;
+    if (deadline == nullptr)
+      error = ::syscall(SYS_futex, &epoch, FUTEX_WAIT_PRIVATE, ticket,
+                        nullptr, nullptr, 0);
+    else
+      // absolute CLOCK_MONOTONIC deadline, EINTR retries keep it.
+      error = ::syscall(SYS_futex, &epoch, FUTEX_WAIT_BITSET_PRIVATE, ticket,
+                        deadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+    if (error == 0 || errno == EAGAIN)
+      break;
+    if (errno == ETIMEDOUT) {
+      woken = false;
+      break;
+    };
+    if (errno != EINTR)
+      break;
+    if (epoch.load(std::memory_order_acquire) != ticket)
+      break;
+  };
+  parked.fetch_add(-1, std::memory_order_relaxed);
+  return woken;
+};
+
+void parkingLot::wake(int n) {
+  // a thread between prepare() and park() sees the new epoch and doesn't
+  // sleep, the ones asleep already get the futex wake.
+  epoch.fetch_add(1, std::memory_order_seq_cst);
+  ::syscall(SYS_futex, &epoch, FUTEX_WAKE_PRIVATE, n > 0 ? n : INT_MAX,
+            nullptr, nullptr, 0);
+};
+
+}; // namespace buffio
@@ -1,19 +1,34 @@
+#include "buffio/cancel.hpp"
 #include "buffio/common.hpp"
+#include "buffio/group.hpp"
 #include "buffio/promise.hpp"
+#include "buffio/scheduler.hpp"
 
-using pstripped = buffio::promise::promise_type;
+using pstripped = buffio::promiseBase;
 
 namespace buffio {
 void promise::run(void *data){
 
   auto queue = buffio::fiber::queue;
-  auto task = (buffio::promise*)data;
-  task->handle.resume();
+  ((buffio::promise *)data)->handle.resume();
+
+  // awaited routines run inline, the resume ends in whichever routine of
+  // the chain is at the head now, if any.
+  auto entry = queue->last();
+  if (entry == nullptr)
+    return;
+  auto task = (buffio::promise *)entry->task.storage;
   auto status = task->paddr->status;
 
-  if(status == buffioRoutineStatus::done){
+  // a routine left by an exception is at its final suspend as well.
+  if(status == buffioRoutineStatus::done ||
+     status == buffioRoutineStatus::unhandledException){
+      auto join = entry->join;
+      auto slot = entry->joinSlot;
       task->handle.destroy();
       queue->pop();
+      if (join != nullptr)
+        buffio::joinState::finish(join, slot);
   }
 
 
@@ -33,15 +48,51 @@ buffioHeader *promise::getHeader(void *data){
   return nullptr;
 };
 
-buffioAwaiter pstripped::await_transform(buffio::promise _promise) {
+std::coroutine_handle<>
+finalAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+  assert(buffio::fiber::queue != nullptr &&
+         "a clamped routine must unclamp before returning");
+  auto waiter = buffio::fiber::queue->get()->waiter;
+  // not awaited by a routine, promise::run finishes it.
+  if (waiter == nullptr)
+    return std::noop_coroutine();
+  return promiseBase::handBack(true);
+};
+
+std::coroutine_handle<> pstripped::handBack(bool finished) {
+  auto queue = buffio::fiber::queue;
+  auto entry = queue->get();
+  auto waiter = entry->waiter;
+  assert(waiter != nullptr);
+
+  queue->replace(waiter);
+  if (finished)
+    queue->release(entry);
+  if (!queue->inlineSwitch())
+    return std::noop_coroutine();
+  return ((buffio::promise *)waiter->task.storage)->get();
+};
+
+std::coroutine_handle<> pstripped::call(buffio::promise _promise) {
 
+  auto child = _promise.get();
   auto entry = buffio::fiber::queue->getEntry();
   buffio::makeContainer::routine(_promise,entry->task);
   entry->waiter = buffio::fiber::queue->get();
-  buffio::fiber::queue->erase();
-  buffio::fiber::queue->push(entry);
+  entry->priority = entry->waiter->priority;
+  entry->deadline = entry->waiter->deadline;
+  if (entry->waiter->cancel != nullptr)
+    buffio::cancelState::bind(entry->waiter->cancel, entry);
+  buffio::fiber::queue->replace(entry);
+
+  if (!buffio::fiber::queue->inlineSwitch())
+    return std::noop_coroutine();
+  return child;
+};
 
-    return {.ready = false};
+buffio::callAwaiter pstripped::await_transform(buffio::promise _promise) {
+  auto child = _promise.get();
+  return {.child = child, .next = call(_promise)};
 };
 
 buffioAwaiter pstripped::await_transform(buffioRoutineStatus ustatus) const {
@@ -49,25 +100,78 @@ buffioAwaiter pstripped::await_transform(buffioRoutineStatus ustatus) const {
 };
 
 buffioAwaiter pstripped::await_transform(buffio::clockSpec::wait wait) {
+  return {.ready = !buffio::fiber::loop->parkFor(wait.ms)};
+};
+
+buffioAwaiter pstripped::await_transform(buffio::clockSpec::deadline deadline) {
+  // requeued with the new deadline, under edf a nearer one runs first.
   auto current = buffio::fiber::queue->get();
-  buffio::fiber::timerClock->push(wait.ms, current);
   buffio::fiber::queue->erase();
+  current->deadline =
+      deadline.us == 0
+          ? 0
+          : buffio::runQueue::now() + (int64_t)deadline.us * 1000;
+  buffio::fiber::queue->push(current);
   return {.ready = false};
 };
 buffioAwaiter pstripped::await_transform(buffioHeader *header) {
-  if (header == nullptr)
-    return {.ready = true};
+  return {.ready = !buffio::fiber::loop->parkOn(header)};
+};
 
-  header->entry = buffio::fiber::queue->get();  
+buffio::joinAwaiter pstripped::await_transform(buffio::joinWait wait) {
+  auto state = wait.state;
+  if (state == nullptr || state->done >= wait.need)
+    return {.state = state, .ready = true};
+
+  // only one routine can wait on a group at a time.
+  assert(state->parent == nullptr);
+  state->need = wait.need;
+  state->parent = buffio::fiber::queue->get();
   buffio::fiber::queue->erase();
+  return {.state = state, .ready = false};
+};
 
-  return {.ready = false};
+buffio::joinAwaiter pstripped::await_transform(buffio::whenAll &&group) {
+  auto awaiter = await_transform(group.all());
+  awaiter.error = group.error();
+  return awaiter;
+};
+
+buffio::joinAwaiter pstripped::await_transform(buffio::whenAny &&group) {
+  auto awaiter = await_transform(group.any());
+  awaiter.error = group.error();
+  return awaiter;
+};
+
+buffioAwaiter pstripped::await_transform(buffio::cancelToken token) {
+  auto current = buffio::fiber::queue->get();
+  if (token.state != nullptr)
+    buffio::cancelState::bind(token.state, current);
+  else if (current->cancel != nullptr)
+    buffio::cancelState::unbind(current);
+  return {.ready = true};
 };
 
 buffioAwaiter pstripped::await_transform(fiber::clampInfo info) {
-  if (info.header == nullptr)
+  // workers don't bind a run queue, that's how a clamped routine knows it
+  // runs on one.
+  auto queue = buffio::fiber::queue;
+  if (!info.toWorker)
+    return {.ready = queue != nullptr};
+
+  if (info.header == nullptr || queue == nullptr ||
+      buffio::fiber::loop->workers() <= 0)
     return {.ready = true};
 
+  // parked like a threaded request, handed to a worker by the loop once
+  // this resume is over, unclamp() ends the request.
+  auto header = info.header;
+  header->entry = queue->get();
+  header->isFresh = true;
+  header->abortCode = 0;
+  header->timerTick = 0;
+  queue->erase();
+  buffio::fiber::threadRequestBatch->push(header);
   return {.ready = false};
 };
 
@@ -1,2 +1,189 @@
 #include "buffio/Queue.hpp"
+#include "buffio/cancel.hpp"
 #include "buffio/fiber.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace buffio {
+
+// std heaps are max-heaps, the nearest deadline has to sit on top.
+static inline bool laterDeadline(const blockQueue *a, const blockQueue *b) {
+  return a->deadline > b->deadline;
+};
+
+runQueue::runQueue()
+    : running(nullptr), resumed(nullptr), selected(nullptr), count(0),
+      switches(0), burst(0), active((size_t)buffioPriority::normal),
+      policy(buffioSchedPolicy::priority) {
+  // called outside the assert, NDEBUG builds still need the pool.
+  int error = memory.init();
+  assert(error == 0);
+  (void)error;
+  weight[(size_t)buffioPriority::latency] = 8;
+  weight[(size_t)buffioPriority::normal] = 4;
+  weight[(size_t)buffioPriority::background] = 1;
+  for (size_t i = 0; i < BUFFIO_PRIORITY_NUM; i++)
+    credit[i] = weight[i];
+};
+
+blockQueue *runQueue::getEntry() {
+  blockQueue *entry = memory.pop();
+  if (entry == nullptr)
+    return nullptr;
+  entry->waiter = nullptr;
+  entry->priority = buffioPriority::normal;
+  entry->deadline = 0;
+  entry->runtime = 0;
+  entry->resumes = 0;
+  entry->overruns = 0;
+  entry->join = nullptr;
+  entry->cancel = nullptr;
+  entry->blocked = nullptr;
+  entry->timer = 0;
+  return entry;
+};
+
+int runQueue::push(blockQueue *entry) {
+  assert(entry != nullptr && (size_t)entry->priority < BUFFIO_PRIORITY_NUM);
+  count += 1;
+  if (queued(entry)) {
+    deadlines.push_back(entry);
+    std::push_heap(deadlines.begin(), deadlines.end(), laterDeadline);
+    return 0;
+  };
+  return level[(size_t)entry->priority].push(entry);
+};
+
+int runQueue::pushHead(blockQueue *entry) {
+  assert(entry != nullptr && (size_t)entry->priority < BUFFIO_PRIORITY_NUM);
+  if (queued(entry))
+    return push(entry);
+  count += 1;
+  return level[(size_t)entry->priority].pushHead(entry);
+};
+
+void runQueue::pop() {
+  blockQueue *entry = get();
+  erase();
+  release(entry);
+};
+
+void runQueue::release(blockQueue *entry) {
+  if (entry == selected)
+    selected = nullptr;
+  account(entry);
+  if (entry->cancel != nullptr)
+    buffio::cancelState::unbind(entry);
+  memory.push(entry);
+};
+
+void runQueue::replace(blockQueue *entry) {
+  assert(entry != nullptr && (size_t)entry->priority < BUFFIO_PRIORITY_NUM);
+  erase();
+  count += 1;
+  // an awaited routine inherits the class and deadline of its caller, so
+  // it normally lands on the very same spot.
+  if (queued(entry)) {
+    running = entry;
+    active = BUFFIO_PRIORITY_NUM;
+  } else {
+    active = (size_t)entry->priority;
+    level[active].pushHead(entry);
+  };
+  resumed = entry;
+};
+
+void runQueue::erase() {
+  resumed = nullptr;
+  burst = 0;
+  if (active == BUFFIO_PRIORITY_NUM) {
+    running = nullptr;
+    active = (size_t)buffioPriority::normal;
+  } else {
+    level[active].erase();
+  };
+  count -= 1;
+};
+
+bool runQueue::selectRound() {
+  if (count == 0)
+    return false;
+  switches = 0;
+
+  // the picked routine leaves the heap while it runs, so routines pushed
+  // meanwhile can't take its place under get()/erase().
+  if (running == nullptr && !deadlines.empty()) {
+    std::pop_heap(deadlines.begin(), deadlines.end(), laterDeadline);
+    running = deadlines.back();
+    deadlines.pop_back();
+    active = BUFFIO_PRIORITY_NUM;
+    resumed = selected = running;
+    return true;
+  };
+
+  for (int round = 0; round < 2; round++) {
+    for (size_t i = 0; i < BUFFIO_PRIORITY_NUM; i++) {
+      if (level[i].empty() || credit[i] == 0)
+        continue;
+      credit[i] -= 1;
+      active = i;
+      resumed = selected = level[i].get();
+      return true;
+    };
+    // every class with work used its share, start a new round.
+    for (size_t i = 0; i < BUFFIO_PRIORITY_NUM; i++)
+      credit[i] = weight[i];
+  };
+  return false;
+};
+
+void runQueue::demote(blockQueue *entry) {
+  if (entry->priority == buffioPriority::background)
+    return;
+  auto lower = (buffioPriority)((size_t)entry->priority + 1);
+
+  if (active != BUFFIO_PRIORITY_NUM && active == (size_t)entry->priority &&
+      level[active].get() == entry) {
+    level[active].erase();
+    count -= 1;
+    resumed = nullptr;
+    burst = 0;
+    entry->priority = lower;
+    push(entry);
+    return;
+  };
+  entry->priority = lower;
+};
+
+void runQueue::setWeight(buffioPriority which, size_t value) {
+  assert((size_t)which < BUFFIO_PRIORITY_NUM);
+  weight[(size_t)which] = value > 0 ? value : 1;
+  credit[(size_t)which] = weight[(size_t)which];
+};
+
+void runQueue::setPolicy(buffioSchedPolicy which) {
+  policy = which;
+  if (policy == buffioSchedPolicy::edf)
+    return;
+
+  for (blockQueue *entry : deadlines)
+    level[(size_t)entry->priority].push(entry);
+  deadlines.clear();
+};
+
+int64_t runQueue::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+};
+
+void runQueue::account(blockQueue *entry) {
+  if (entry->deadline == 0 || entry->waiter != nullptr)
+    return;
+  if (now() > entry->deadline)
+    misses.missed += 1;
+  else
+    misses.met += 1;
+};
+
+}; // namespace buffio
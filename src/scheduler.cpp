@@ -1,9 +1,16 @@
 #include "buffio/scheduler.hpp"
+#include "buffio/cancel.hpp"
 #include "buffio/enum.hpp"
 #include "buffio/fiber.hpp"
 #include "buffio/promise.hpp"
 #include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <time.h>
 #include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #define BUFFIO_FIBER_SETUP(AFTER_SETUP)                                        \
   buffio::fiber::poller = &this->poller;                                       \
@@ -11,6 +18,13 @@
   buffio::fiber::timerClock = &this->timerClock;                               \
   buffio::fiber::requestBatch = &this->requestBatch;                           \
   buffio::fiber::threadRequestBatch = &this->threadRequestBatch;               \
+  buffio::fiber::loop = this;                                                  \
+  buffio::fiber::state = &this->state;                                         \
+  buffio::fiber::ring = this->ring.active() ? &this->ring : nullptr;           \
+  buffio::fiber::frames = &this->frames;                                       \
+  buffio::fiber::stacks = &this->stacks;                                       \
+  buffio::fiber::headers = &this->clampHeaders;                                \
+  buffio::fiber::compute = &this->compute;                                     \
   AFTER_SETUP
 
 namespace buffio {
@@ -23,23 +37,57 @@ scheduler::scheduler(int workerNum, int queueOrder) : workerlNum(0) {
   workerlNum = workerNum;
 };
 scheduler::~scheduler() {
+  // only unbind the calling thread if it is bound to this instance
+  if (buffio::fiber::loop != this)
+    return;
+
   buffio::fiber::poller = nullptr;
   buffio::fiber::queue = nullptr;
   buffio::fiber::timerClock = nullptr;
   buffio::fiber::requestBatch = nullptr;
   buffio::fiber::threadRequestBatch = nullptr;
+  buffio::fiber::loop = nullptr;
+  buffio::fiber::state = nullptr;
+  buffio::fiber::ring = nullptr;
+  buffio::fiber::frames = nullptr;
+  buffio::fiber::stacks = nullptr;
+  buffio::fiber::headers = nullptr;
+  buffio::fiber::compute = nullptr;
 };
+void scheduler::bind() { BUFFIO_FIBER_SETUP() };
+
 void scheduler::clean(int tries, int timeout) {
+  // routines still in the inbox are owned by the loop as well.
+  if (poller.running())
+    drainInbox(1 << BUFFIO_POST_ORDER);
   cleanQueue();
-  shutWorker(workerlNum, tries, timeout);
+  compute.stop();
+  // worker stacks are only released once every worker has exited,
+  // freeing them under a running worker is a use after free.
+  if (shutWorker(workerlNum, tries, timeout) != 0)
+    return;
+  threadPool.join();
   threadPool.free();
 }
 int scheduler::init(int workerNum, int queueOrder) {
   int error = 0;
-  if ((error = poller.start(threadPool, workerNum, queueOrder)) != 0)
+  BUFFIO_FIBER_SETUP();
+  // placed before anything is allocated, so the queues are node local.
+  if (homeNode >= 0) {
+    if ((error = buffio::thread::pin({.cpu = -1, .node = homeNode})) != 0)
+      return error;
+  } else if (buffio::topology::nodes() > 1) {
+    homeNode = buffio::topology::affinityNode();
+  };
+  if ((error = poller.start(threadPool, &state, workerNum, queueOrder,
+                            homeNode)) != 0)
     return error;
   if ((error = buffio::MakeFd::eventFd(evFd, 0)) != 0)
     return error;
+  if (inbox.lfstart(BUFFIO_POST_ORDER) != 0)
+    return (int)buffioErrorCode::postInbox;
+  if (clampHeaders.init(BUFFIO_CLAMP_HEADERS) != 0)
+    return (int)buffioErrorCode::clampHeaders;
   if ((error = poller.pollMod(evFd.getFd(), &evFd, EPOLLIN | EPOLLET)) != 0) {
     evFd.release();
     return error;
@@ -47,11 +95,24 @@ int scheduler::init(int workerNum, int queueOrder) {
   workerlNum = workerNum;
   poller.mountFd(evFd.getFd());
 
+  // completions signal the eventfd already polled by the loop.
+  if (backendType == buffioBackend::uring) {
+    if (ring.init(256, evFd.getFd()) != 0)
+      backendType = buffioBackend::epoll;
+    else
+      (void)ring.registerBuffers(bufferSize, bufferNum);
+    BUFFIO_FIBER_SETUP();
+  };
+
   return 0;
 }
 int scheduler::run() {
 
-  if (queue.empty())
+  BUFFIO_FIBER_SETUP();
+
+  // a member of a steal group stays up to steal from its peers.
+  if (group == nullptr && queue.empty() && inbox.empty() &&
+      !alive.load(std::memory_order_acquire))
     return (int)buffioErrorCode::unknown;
 
   struct epoll_event evnt[1024];
@@ -59,59 +120,71 @@ int scheduler::run() {
   bool exit = false;
   bool check = false;
   int timeout = 0;
-  timerClock.pushExpired(queue);
+  expireTimers();
 
   while (exit != true) {
 
+    if (group != nullptr)
+      balance();
+
     timeout = getWakeTime(&exit);
-    int nfd = poller.poll(evnt, 1024, timeout);
+    if (group != nullptr && (exit || groupIdling))
+      exit = groupIdle(&timeout, exit);
+    if (ring.prepared() != 0)
+      ring.submit();
+    int nfd = pollEvents(evnt, 1024, timeout);
 
     if (timeout < 0)
-      buffio::fiber::loopWakedUp.compare_exchange_weak(
+      state.loopWakedUp.compare_exchange_weak(
           check, true, std::memory_order_acq_rel);
 
-    if (nfd < 0)
+    // io_uring task work interrupts the wait of the submitting thread.
+    if (nfd < 0 && errno != EINTR)
       break;
-    if (nfd != 0)
+    if (nfd > 0)
       processEvents(evnt, nfd);
+    if (ring.inflight() != 0)
+      reapRing(100);
 
     dequeueThreadQueue(100);
-    yieldQueue(100);
+    drainInbox(100);
+    yieldQueue(BUFFIO_YIELD_PASS_NS);
 
     if (!threadRequestBatch.empty())
       processThreadRequest();
+    poller.scale();
     if (!requestBatch.empty())
       consumeBatch(100);
     if (!timerClock.empty())
-      timerClock.pushExpired(queue);
+      expireTimers();
   };
   return 0;
 };
 
-void scheduler::shutWorker(int workerNum, int tries, long wait) {
+size_t scheduler::shutWorker(int workerNum, int tries, long wait) {
 
   size_t workerCount =
-      buffio::fiber::workerCount.load(std::memory_order_acquire);
+      state.workerCount.load(std::memory_order_acquire);
 
-  buffio::fiber::abort.store(-10, std::memory_order_release);
+  state.abort.store(-10, std::memory_order_release);
 
-  for (size_t j = 0; j < workerCount; j++)
-    poller.ping();
+  poller.wakeAll();
 
   struct timespec ts;
   ts.tv_sec = wait / 1000;
   ts.tv_nsec = (wait % 1000) * 100000L;
 
   ::nanosleep(&ts, &ts);
-  workerCount = buffio::fiber::workerCount.load(std::memory_order_acquire);
+  workerCount = state.workerCount.load(std::memory_order_acquire);
 
   for (size_t i = workerCount; i > 0;) {
     ::nanosleep(&ts, &ts);
-    i = buffio::fiber::workerCount.load(std::memory_order_acquire);
+    i = state.workerCount.load(std::memory_order_acquire);
     tries -= 1;
     if (tries < 0)
       break;
   };
+  return state.workerCount.load(std::memory_order_acquire);
 };
 int scheduler::processEvents(struct epoll_event evnts[], int len) {
   for (int i = 0; i < len; i++) {
@@ -131,20 +204,214 @@ int scheduler::processEvents(struct epoll_event evnts[], int len) {
   return 0;
 };
 
+char *scheduler::getBuffer() {
+  char *buffer = ring.getBuffer();
+  if (buffer != nullptr)
+    return buffer;
+  try {
+    buffer = new char[bufferSize];
+  } catch (std::exception &e) {
+    return nullptr;
+  };
+  return buffer;
+};
+
+void scheduler::putBuffer(char *buffer) {
+  if (buffer == nullptr || ring.putBuffer(buffer))
+    return;
+  delete[] buffer;
+};
+
+void scheduler::reapRing(int cycle) {
+  buffioHeader *header = nullptr;
+  int res = 0;
+  int count = 0;
+
+  while (count < cycle && ring.complete(&header, &res)) {
+    header->aux = res;
+    header->opError = res < 0 ? -res : 0;
+    header->action(header);
+    // an aborted operation that completed anyway keeps its result.
+    if (header->abortCode != 0 && res == -ECANCELED)
+      header->opError = header->abortCode;
+    state.pendingReq.fetch_add(-1, std::memory_order_acq_rel);
+    completed(header);
+    count += 1;
+  };
+};
+
+#define BUFFIO_BUSY_BACKOFF 16
+#define BUFFIO_BUSY_BACKOFF_MAX 4096
+
+int scheduler::pollEvents(struct epoll_event evnts[], int len, int timeout) {
+  if (timeout == 0 || busy.max == 0)
+    return poller.poll(evnts, len, timeout);
+
+  // spinning kept missing, park straight away for a while, then probe
+  // again with a short budget.
+  if (busy.budget == 0) {
+    if (busySkip > 0) {
+      busySkip -= 1;
+      return poller.poll(evnts, len, timeout);
+    };
+    busy.budget = busy.max / 8 > 0 ? busy.max / 8 : 1;
+  };
+
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+
+  long spin = busy.budget;
+  if (timeout > 0 && spin > timeout * 1000L)
+    spin = timeout * 1000L;
+
+  auto until = start + std::chrono::microseconds(spin);
+  do {
+    int nfd = poller.poll(evnts, len, 0);
+    if (nfd != 0) {
+      busy.hits += 1;
+      busy.budget = busy.budget * 2 > busy.max ? busy.max : busy.budget * 2;
+      busyBackoff = BUFFIO_BUSY_BACKOFF;
+      return nfd;
+    };
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  } while (clock::now() < until);
+
+  busy.misses += 1;
+  busy.budget /= 2;
+  if (busy.budget < busy.max / 16 || busy.budget == 0) {
+    busy.budget = 0;
+    busySkip = busyBackoff;
+    if (busyBackoff < BUFFIO_BUSY_BACKOFF_MAX)
+      busyBackoff *= 2;
+  };
+
+  if (timeout > 0) {
+    auto spent = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     clock::now() - start)
+                     .count();
+    timeout = spent >= timeout ? 0 : timeout - (int)spent;
+  };
+  return poller.poll(evnts, len, timeout);
+};
+#undef BUFFIO_BUSY_BACKOFF
+#undef BUFFIO_BUSY_BACKOFF_MAX
+
 int scheduler::consumeBatch(int cycle) {
 
   int count = cycle < requestBatch.gcount() ? cycle : requestBatch.gcount();
   while (0 < count) {
     auto req = requestBatch.get();
     req->action(req);
-    queue.push(req->entry);
     requestBatch.pop();
+    completed(req);
+    count -= 1;
   };
   return 0;
 };
 
+void scheduler::expireTimers() {
+  timerClock.pushExpired(queue);
+  timerClock.expireDeadlines(
+      [](buffioHeader *header, void *data) {
+        ((buffio::scheduler *)data)
+            ->abortHeader(header, (int)buffioErrorCode::timeout);
+      },
+      this);
+};
+
+static inline bool uringAction(buffioAction action) {
+  return action == buffio::action::uringReadWrite ||
+         action == buffio::action::uringAccept ||
+         action == buffio::action::uringConnect ||
+         action == buffio::action::uringPoll;
+};
+
+bool scheduler::abortWait(blockQueue *entry) {
+  if (timerClock.cancel(entry)) {
+    queue.push(entry);
+    return true;
+  };
+
+  buffioHeader *header = entry->blocked;
+  if (header == nullptr || header->entry != entry)
+    return false;
+  return abortHeader(header, (int)buffioErrorCode::cancelled);
+};
+
+bool scheduler::parkOn(buffioHeader *header) {
+  if (header == nullptr)
+    return false;
+
+  auto current = queue.get();
+  header->entry = current;
+  current->blocked = header;
+  queue.erase();
+
+  // issued after the cancel, abort it straight away.
+  if (current->cancel != nullptr && current->cancel->cancelled)
+    abortWait(current);
+  return true;
+};
+
+bool scheduler::parkFor(size_t ms) {
+  auto current = queue.get();
+  if (current->cancel != nullptr && current->cancel->cancelled)
+    return false;
+  timerClock.push(ms, current);
+  queue.erase();
+  return true;
+};
+
+bool scheduler::abortHeader(buffioHeader *header, int code) {
+  if (header->abortCode != 0)
+    return false;
+
+  // still queued for a worker, processThreadRequest completes it as
+  // aborted, once a worker took it the syscall can't be stopped anymore.
+  if (header->action == buffio::action::readFile ||
+      header->action == buffio::action::writeFile) {
+    if (header->onWorker)
+      return false;
+    header->abortCode = code;
+    return true;
+  };
+
+  if (!header->isFresh)
+    return false;
+
+  // in flight in the ring, resumes on its -ECANCELED completion.
+  if (uringAction(header->action)) {
+    if (ring.abort(header) != 0)
+      return false;
+    header->abortCode = code;
+    return true;
+  };
+
+  header->abortCode = code;
+
+  // parked on the fd until it gets ready.
+  auto fd = header->fd;
+  if (fd != nullptr &&
+      (fd->pendingReadReq == header || fd->pendingWriteReq == header)) {
+    if (fd->pendingReadReq == header)
+      fd->pendingReadReq = nullptr;
+    else
+      fd->pendingWriteReq = nullptr;
+    state.pendingReq.fetch_add(-1, std::memory_order_acq_rel);
+    buffio::action::aborted(header);
+    completed(header);
+    return true;
+  };
+
+  // queued in the request batch, it resumes through consumeBatch().
+  header->action = buffio::action::aborted;
+  return true;
+};
+
 void scheduler::cleanQueue() {
-  while (!queue.empty()) {
+  while (queue.select()) {
     auto handle = queue.get();
     if (handle->waiter)
       handle->waiter->task.destroy(handle->waiter->task.storage);
@@ -153,73 +420,318 @@ void scheduler::cleanQueue() {
   };
 };
 
+#define BUFFIO_STEAL_BATCH 16
+#define BUFFIO_STEAL_IDLE_MS 1
+
+int scheduler::spawn(buffio::promise task) {
+  if (offer(task))
+    return 0;
+  return push(task);
+};
+
+bool scheduler::offer(buffio::promise task) {
+  if (group == nullptr)
+    return false;
+  return group->deque[groupSelf].push(task.get().address());
+};
+
+void scheduler::attach(buffio::stealGroup *stealers, size_t self) {
+  assert(stealers == nullptr || self < stealers->num);
+  group = stealers;
+  groupSelf = self;
+  stealNext = self + 1;
+};
+
+size_t scheduler::balance() {
+  if (group == nullptr || queue.gcount() >= BUFFIO_STEAL_BATCH)
+    return 0;
+
+  size_t moved = drainRunnable(BUFFIO_STEAL_BATCH - queue.gcount());
+  if (moved == 0 && queue.empty())
+    moved = steal(BUFFIO_STEAL_BATCH);
+  return moved;
+};
+
+size_t scheduler::drainRunnable(size_t batch) {
+  auto &own = group->deque[groupSelf];
+  size_t i = 0;
+  for (; i < batch; i++) {
+    void *frame = own.pop(nullptr);
+    if (frame == nullptr)
+      break;
+    push(buffio::promise(buffio::promiseHandle::from_address(frame)));
+  };
+  return i;
+};
+
+size_t scheduler::steal(size_t batch) {
+  size_t got = 0;
+
+  // round-robin over the peers so thieves don't all hit the same victim.
+  for (size_t n = 0; n < group->num && got == 0; n++, stealNext++) {
+    size_t victim = stealNext % group->num;
+    if (victim == groupSelf)
+      continue;
+
+    auto &peer = group->deque[victim];
+    size_t take = peer.size() / 2 + 1;
+    take = take < batch ? take : batch;
+
+    for (size_t i = 0; i < take; i++) {
+      void *frame = peer.steal(nullptr);
+      if (frame == nullptr)
+        break;
+      push(buffio::promise(buffio::promiseHandle::from_address(frame)));
+      got += 1;
+    };
+  };
+  stealCount += got;
+  return got;
+};
+
+/*
+ * a steal group member out of work stays counted as idle and steals again
+ * every BUFFIO_STEAL_IDLE_MS, it exits only once every member of the group
+ * was idle at the same time.
+ */
+bool scheduler::groupIdle(int *timeout, bool idle) {
+  if (!idle) {
+    // work showed up on its own, an event or a post.
+    groupIdling = false;
+    group->idle.fetch_sub(1, std::memory_order_seq_cst);
+    return false;
+  };
+  if (!groupIdling) {
+    groupIdling = true;
+    group->idle.fetch_add(1, std::memory_order_seq_cst);
+  };
+  if (group->idle.load(std::memory_order_seq_cst) == group->num)
+    group->done.store(true, std::memory_order_release);
+  if (group->done.load(std::memory_order_acquire))
+    return true;
+
+  // not idle while stealing, the group can't finish with a stolen routine
+  // on its way to this loop.
+  group->idle.fetch_sub(1, std::memory_order_seq_cst);
+  if (steal(BUFFIO_STEAL_BATCH) != 0) {
+    groupIdling = false;
+    *timeout = 0;
+    return false;
+  };
+  group->idle.fetch_add(1, std::memory_order_seq_cst);
+  *timeout = BUFFIO_STEAL_IDLE_MS;
+  return false;
+};
+#undef BUFFIO_STEAL_IDLE_MS
+#undef BUFFIO_STEAL_BATCH
+
 #define _CHK(name) name.empty()
 
 int scheduler::getWakeTime(bool *flag) {
 
   int looptime = timerClock.getNext();
   ssize_t nqueue =
-      buffio::fiber::queuedCompleted.load(std::memory_order_acquire);
-  bool n = true;
+      state.queuedCompleted.load(std::memory_order_acquire);
 
   if (_CHK(!queue) || _CHK(!requestBatch) || _CHK(!threadRequestBatch) ||
-      nqueue > 0) {
+      _CHK(!inbox) || nqueue > 0) {
     return 0;
   };
 
-  ssize_t req = buffio::fiber::pendingReq.load(std::memory_order_acquire);
+  ssize_t req = state.pendingReq.load(std::memory_order_acquire);
   if (req > 0) {
-    if (looptime < 0)
-      buffio::fiber::loopWakedUp.compare_exchange_weak(
-          n, false, std::memory_order_acq_rel);
+    if (looptime < 0) {
+      state.loopWakedUp.store(false, std::memory_order_seq_cst);
+      // a worker finishing before the flag was cleared skipped the
+      // eventfd write, don't sleep on its completion.
+      if (state.queuedCompleted.load(std::memory_order_seq_cst) > 0 ||
+          state.pendingReq.load(std::memory_order_seq_cst) <= 0)
+        return 0;
+    };
 
     return looptime;
   }
 
-  *flag = (queue.empty() & timerClock.empty()) == true ? true : false;
-  buffio::fiber::loopWakedUp.store(false, std::memory_order_release);
+  // kept alive, park until a post (or keepAlive(false)) writes the eventfd.
+  *flag = (queue.empty() & timerClock.empty() &
+           !alive.load(std::memory_order_acquire)) == true
+              ? true
+              : false;
+  state.loopWakedUp.store(false, std::memory_order_release);
 
-  return 0;
+  // only timers left, sleep until the next one instead of spinning.
+  return *flag ? 0 : looptime;
 };
 #undef _CHK
 
-int scheduler::yieldQueue(int chunk) {
+static inline uint64_t rawNs() {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+};
 
-  int count = chunk < queue.gcount() ? chunk : queue.gcount();
-  while (0 < count && !queue.empty()) {
+/*
+ * slice clock, the TSC calibrated once against CLOCK_MONOTONIC_RAW on x86
+ * (about half the cost of the vdso call), the raw clock elsewhere.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t sliceTicks() { return __rdtsc(); };
+static double sliceNsPerTick() {
+  static const double ratio = []() {
+    uint64_t ns = rawNs(), ticks = __rdtsc();
+    while (rawNs() - ns < 200000)
+      ;
+    return (double)(rawNs() - ns) / (double)(__rdtsc() - ticks);
+  }();
+  return ratio;
+};
+#else
+static inline uint64_t sliceTicks() { return rawNs(); };
+static double sliceNsPerTick() { return 1.0; };
+#endif
+
+int scheduler::yieldQueue(uint64_t budget) {
+
+  // with a slice (or the stats) every resume is timed, the time between
+  // two resumes is charged to the later one. untimed, the clock is only
+  // read every BUFFIO_YIELD_CHECK resumes to end the pass.
+  const bool timed = slice.limit != 0 || slice.timed;
+  const double nsPerTick = sliceNsPerTick();
+  uint64_t start = sliceTicks();
+  const uint64_t until = start + (uint64_t)(budget / nsPerTick);
+  size_t resumes = 0;
+
+  while (queue.select()) {
     auto task = queue.get();
-    task->task.run(task->task.storage);
+    // a class is run round robin, warm up the entry coming next.
+    __builtin_prefetch(task->next);
+
+    // task may be back in the pool and handed to a new routine after a
+    // run, it is only touched again while it is the head the queue vouches
+    // for. still at the head means it yielded, it goes again for a short
+    // burst (within the pass) before it is rotated behind its peers.
+    blockQueue *last = nullptr;
+    do {
+      task->resumes += 1;
+      task->task.run(task->task.storage);
+      last = queue.last();
+      if (timed) {
+        uint64_t end = sliceTicks();
+        chargeSlice((uint64_t)((end - start) * nsPerTick), last);
+        start = end;
+      } else if (++resumes % BUFFIO_YIELD_CHECK == 0) {
+        start = sliceTicks();
+      };
+    } while (last == task && start < until && queue.rerun(last));
+
+    if (last != nullptr)
+      queue.yielded(last);
+    if (start >= until)
+      break;
   };
   return 0;
 };
 
+void scheduler::chargeSlice(uint64_t ran, blockQueue *&last) {
+  // the run is charged to the routine picked, whatever it awaited ran
+  // inside of it, nullptr once it finished.
+  auto owner = queue.picked();
+  if (owner != nullptr)
+    owner->runtime += ran;
+  if (ran > slice.longest)
+    slice.longest = ran;
+  if (slice.limit == 0 || ran <= slice.limit)
+    return;
+
+  slice.overruns += 1;
+  if (owner != nullptr)
+    owner->overruns += 1;
+  if (slice.action == buffioSliceAction::demote &&
+      (last != nullptr || owner != nullptr)) {
+    queue.demote(last != nullptr ? last : owner);
+    last = queue.last(); // requeued at the tail of its new class.
+  };
+};
+
 void scheduler::processThreadRequest() {
 
   size_t i = 0;
 
   while (!threadRequestBatch.empty()) {
     buffioHeader *header = threadRequestBatch.get();
-    poller.push(header);
     threadRequestBatch.pop();
+    // aborted before a worker got it, never handed out.
+    if (header->abortCode != 0) {
+      buffio::action::aborted(header);
+      completed(header);
+      continue;
+    };
+    header->onWorker = true;
+    poller.push(header);
     i += 1;
   };
 
-  buffio::fiber::pendingReq.fetch_add(i, std::memory_order_acq_rel);
+  state.pendingReq.fetch_add(i, std::memory_order_acq_rel);
+  poller.wake(i);
+};
 
-  auto sleeping = buffio::fiber::sleepingThread.load(std::memory_order_acquire);
-  ssize_t value = 0;
-  size_t wakevalue = i;
+int scheduler::post(buffio::promise task, buffioPriority priority) {
+  buffio::postTask item;
+  buffio::makeContainer::routine(task, item.task);
+  item.priority = priority;
+  return enqueuePost(item);
+};
 
-  wakevalue = (i - sleeping) > 0 ? sleeping : i;
+int scheduler::post(buffio::containerCallback callback, void *data,
+                    buffioPriority priority) {
+  buffio::postTask item;
+  buffio::makeContainer::function(callback, data, item.task);
+  item.priority = priority;
+  return enqueuePost(item);
+};
 
-  for (ssize_t i = 0; i < wakevalue; i++) {
-    poller.ping();
-  }
+int scheduler::enqueuePost(const buffio::postTask &item) {
+  if (!poller.running())
+    return (int)buffioErrorCode::epollInstance;
+  if (!inbox.enqueue(item))
+    return (int)buffioErrorCode::postFull;
+
+  // the loop clears the flag before draining, whoever sets it again after
+  // that owes the loop a wakeup.
+  if (!inboxSignal.exchange(true, std::memory_order_acq_rel)) {
+    postWakes.fetch_add(1, std::memory_order_relaxed);
+    ::eventfd_write(evFd.getFd(), 1);
+  };
+  return 0;
+};
+
+void scheduler::keepAlive(bool on) {
+  alive.store(on, std::memory_order_release);
+  if (!on && poller.running())
+    ::eventfd_write(evFd.getFd(), 1);
+};
+
+void scheduler::drainInbox(int cycle) {
+  if (!inboxSignal.load(std::memory_order_acquire) && inbox.empty())
+    return;
+  inboxSignal.exchange(false, std::memory_order_acq_rel);
+
+  buffio::postTask none;
+  none.task.run = nullptr;
+  for (int i = 0; i < cycle; i++) {
+    buffio::postTask item = inbox.dequeue(none);
+    if (item.task.run == nullptr)
+      break;
+    auto entry = queue.getEntry();
+    entry->task = item.task;
+    entry->priority = item.priority;
+    queue.push(entry);
+  };
 };
 
 void scheduler::dequeueThreadQueue(int nentry) {
   ssize_t nqueue =
-      buffio::fiber::queuedCompleted.load(std::memory_order_acquire);
+      state.queuedCompleted.load(std::memory_order_acquire);
   ssize_t value = nqueue;
   if (value == 0)
     return;
@@ -230,12 +742,16 @@ void scheduler::dequeueThreadQueue(int nentry) {
   if ((nentry - nqueue) < 0)
     value = nentry;
 
-  for (ssize_t i = 0; i < value; i++) {
+  // the first pop detaches every published batch, the rest walk it.
+  ssize_t taken = 0;
+  for (; taken < value; taken++) {
     auto header = poller.pop();
-    queue.push(header->entry);
+    if (header == nullptr)
+      break;
+    completed(header);
   };
-  auto nvalue = buffio::fiber::queuedCompleted.fetch_sub(
-      value, std::memory_order_acq_rel);
+  auto nvalue = state.queuedCompleted.fetch_sub(
+      taken, std::memory_order_acq_rel);
 
   return;
 };
@@ -0,0 +1,192 @@
+#include "buffio/shard.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace buffio {
+
+shards::~shards() {
+  join();
+  if (shard != nullptr)
+    delete[] shard;
+  shard = nullptr;
+
+  // every shard emptied its own deque before its frame pool went away.
+  if (deques != nullptr)
+    delete[] deques;
+  deques = nullptr;
+};
+
+int shards::start(int shardNum, setupRoutine setup, void *data, int workerNum,
+                  int queueOrder, bool pin) {
+
+  if (shardNum <= 0 || setup == nullptr)
+    return (int)buffioErrorCode::shardNum;
+  if (shard != nullptr)
+    return (int)buffioErrorCode::occupied;
+
+  try {
+    shard = new shardInfo[shardNum];
+  } catch (std::exception &e) {
+    return (int)buffioErrorCode::makeUnique;
+  };
+
+  this->setup = setup;
+  this->data = data;
+  launched.store(false, std::memory_order_release);
+  finished.store(0, std::memory_order_release);
+  cleaned.store(0, std::memory_order_release);
+
+  if (stealing) {
+    try {
+      deques = new buffio::stealDeque<void *>[shardNum];
+    } catch (std::exception &e) {
+      delete[] shard;
+      shard = nullptr;
+      return (int)buffioErrorCode::makeUnique;
+    };
+    for (int i = 0; i < shardNum; i++) {
+      if (deques[i].init(stealOrder) != 0) {
+        delete[] deques;
+        delete[] shard;
+        deques = nullptr;
+        shard = nullptr;
+        return (int)buffioErrorCode::queueSize;
+      };
+    };
+    group.deque = deques;
+    group.num = (size_t)shardNum;
+    group.idle.store(0, std::memory_order_release);
+    group.done.store(false, std::memory_order_release);
+  };
+
+  long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus <= 0)
+    cpus = 1;
+
+  for (int i = 0; i < shardNum; i++) {
+    shard[i].parent = this;
+    shard[i].id = i;
+    shard[i].cpu = pin ? (int)(i % cpus) : -1;
+    shard[i].workerNum = workerNum;
+    shard[i].queueOrder = queueOrder;
+    shard[i].errorCode.store(0, std::memory_order_release);
+    shard[i].loop.store(nullptr, std::memory_order_release);
+    shard[i].stolen = 0;
+  };
+
+  for (int i = 0; i < shardNum; i++) {
+    // the stack is taken from the node the shard is pinned to.
+    int node = shard[i].cpu >= 0 ? buffio::topology::nodeOf(shard[i].cpu) : -1;
+    if (threads.run(nullptr, shards::shardMain, &shard[i], buffio::thread::SD,
+                    {.cpu = -1, .node = node}) != 0) {
+      this->shardNum = i;
+      // shards never started can't keep the group from finishing.
+      group.idle.fetch_add(shardNum - i, std::memory_order_acq_rel);
+      launched.store(true, std::memory_order_release);
+      return (int)buffioErrorCode::threadRun;
+    }
+    this->shardNum = i + 1;
+  };
+  launched.store(true, std::memory_order_release);
+
+  return (int)buffioErrorCode::none;
+};
+
+void shards::join() {
+  if (shardNum == 0 || joined)
+    return;
+  threads.join();
+  threads.free();
+  joined = true;
+};
+
+buffio::scheduler *shards::get(int shardId) const {
+  if (shard == nullptr || shardId < 0 || (size_t)shardId >= shardNum)
+    return nullptr;
+  return shard[shardId].loop.load(std::memory_order_acquire);
+};
+
+int shards::error(int shardId) const {
+  if (shard == nullptr || shardId < 0 || (size_t)shardId >= shardNum)
+    return (int)buffioErrorCode::shardNum;
+  return shard[shardId].errorCode.load(std::memory_order_acquire);
+};
+
+size_t shards::stolen(int shardId) const {
+  if (shard == nullptr || shardId < 0 || (size_t)shardId >= shardNum)
+    return 0;
+  return shard[shardId].stolen;
+};
+
+void shards::leave() {
+  // a shard that never runs counts as idle for the whole group.
+  if (stealing)
+    group.idle.fetch_add(1, std::memory_order_acq_rel);
+  rendezvous(finished);
+  rendezvous(cleaned);
+};
+
+void shards::rendezvous(std::atomic<size_t> &count) {
+  count.fetch_add(1, std::memory_order_acq_rel);
+  // shardNum is final once every thread is launched.
+  while (!launched.load(std::memory_order_acquire) ||
+         count.load(std::memory_order_acquire) < shardNum)
+    ::sched_yield();
+};
+
+int shards::shardMain(void *data) {
+  shardInfo *info = (shardInfo *)data;
+  shards *parent = info->parent;
+  int error = 0;
+
+  // the loop and the workers it starts stay on the node of the cpu.
+  if (info->cpu >= 0 && buffio::thread::pin({.cpu = info->cpu}) != 0) {
+    info->errorCode.store((int)buffioErrorCode::affinity,
+                          std::memory_order_release);
+    parent->leave();
+    return -1;
+  };
+
+  buffio::scheduler loop;
+  if ((error = loop.init(info->workerNum, info->queueOrder)) != 0) {
+    loop.clean();
+    info->errorCode.store(error, std::memory_order_release);
+    parent->leave();
+    return -1;
+  };
+
+  if (parent->stealing)
+    loop.attach(&parent->group, info->id);
+
+  info->loop.store(&loop, std::memory_order_release);
+
+  if ((error = parent->setup(loop, info->id, parent->data)) >= 0)
+    error = loop.run();
+  else if (parent->stealing)
+    parent->group.idle.fetch_add(1, std::memory_order_acq_rel);
+
+  info->loop.store(nullptr, std::memory_order_release);
+  info->stolen = loop.stolen();
+
+  // routines stolen from (or posted by) this shard still run on the peers
+  // and release their frames into its pool, wait until every loop is out
+  // of run() before touching it.
+  parent->rendezvous(parent->finished);
+
+  // nobody steals anymore, routines left on the deque were never started.
+  if (parent->stealing) {
+    void *frame = nullptr;
+    while ((frame = parent->deques[info->id].pop(nullptr)) != nullptr)
+      buffio::promiseHandle::from_address(frame).destroy();
+  };
+  loop.clean();
+
+  // the queues cleaned by the peers can hold frames of this pool too.
+  parent->rendezvous(parent->cleaned);
+  info->errorCode.store(error, std::memory_order_release);
+
+  return 0;
+};
+
+}; // namespace buffio
@@ -5,59 +5,327 @@
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <ctime>
 #include <sys/socket.h>
 #include <sys/types.h>
 
 namespace buffio {
+static uint64_t monotonicNs() {
+  struct timespec now;
+  ::clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+};
+
+// a file transfer takes about as long as the previous one, anything else
+// (a clamped routine, a socket or pipe read) may take any time.
+static inline bool fileAction(buffioHeader *header) {
+  return header->action == buffio::action::readFile ||
+         header->action == buffio::action::writeFile ||
+         header->action == buffio::action::asyncReadFile ||
+         header->action == buffio::action::asyncWriteFile;
+};
+
 int sockBroker::worker(void *data) {
   buffio::sockBroker *parent = (buffio::sockBroker *)data;
   buffioSockBrokerQueue *workQueue = &parent->epollWorks;
-  buffioSockBrokerQueue *consumeQueue = &parent->epollConsume;
+  buffio::fiber::loopState *state = parent->state;
   bool exit = false;
+  bool retiring = false;
   ssize_t abort = 0;
 
-  buffio::fiber::workerCount.fetch_add(1, std::memory_order_acq_rel);
+  // completions not published yet, newest first.
+  buffioHeader *head = nullptr;
+  buffioHeader *tail = nullptr;
+  size_t held = 0;
+  uint64_t heldSince = 0;
+
+  // nothing left to batch with, the loop gets them before we go on.
+  auto flush = [&]() {
+    if (held == 0)
+      return;
+    parent->publish(head, tail, held);
+    head = tail = nullptr;
+    held = 0;
+  };
+
+  buffio::fiber::state = state;
+
+  long spin = parent->spinMax;
+
+  // counted in workerCount by the thread starting it, see spawn().
   while (exit != true) {
-    abort = buffio::fiber::abort.load(std::memory_order_acquire);
+    abort = state->abort.load(std::memory_order_acquire);
     if (abort < 0)  break;
 
-    if (workQueue->empty()) {
-      buffio::fiber::sleepingThread.fetch_add(1,std::memory_order_acq_rel);
-      ::sem_wait(&parent->buffioWorkerSignal);
-      buffio::fiber::sleepingThread.fetch_add(-1,std::memory_order_acq_rel);
-      
-      abort = buffio::fiber::abort.load(std::memory_order_acquire);
-      if (abort < 0) break;
+    // claimed before the dequeue, an empty queue is known without missing
+    // on it, which costs the ring a long retry.
+    if (!parent->claim()) {
+      flush();
+      bool woken = parent->park(spin);
+      if (!woken && parent->retire()) {
+        retiring = true;
+        break;
+      };
+      continue;
     };
 
-    buffioHeader *tmpWork = workQueue->dequeue(nullptr);
-    if (tmpWork == nullptr)
-      continue;
+    buffioHeader *tmpWork;
+    while ((tmpWork = workQueue->dequeue(nullptr)) == nullptr) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    };
+
+    // held completions wait for this action too, they go to the loop first
+    // unless it is a file transfer and the hold has time left.
+    if (held != 0 &&
+        (!fileAction(tmpWork) ||
+         monotonicNs() - heldSince >= BUFFIO_COMPLETION_HOLD_NS))
+      flush();
 
     tmpWork->action(tmpWork);
+    uint64_t ended = monotonicNs();
 
-    while(!consumeQueue->enqueue(tmpWork)){ 
-     struct timespec ts;
-     ts.tv_sec = 10 / 1000;
-     ts.tv_nsec = (10 % 1000) * 100000L;
-     ::nanosleep(&ts, &ts);
-    }
+    tmpWork->next = head;
+    head = tmpWork;
+    if (held++ == 0) {
+      tail = tmpWork;
+      heldSince = ended;
+    };
+    // held only while more requests are queued, a lone request goes back
+    // right away.
+    if (held >= BUFFIO_COMPLETION_BATCH || !parent->queued() ||
+        ended - heldSince >= BUFFIO_COMPLETION_HOLD_NS)
+      flush();
+  };
+  flush();
+  // a retiring worker left the count already.
+  if (!retiring)
+    state->workerCount.fetch_add(-1, std::memory_order_acq_rel);
+
+  return 0;
+};
+
+void sockBroker::publish(buffioHeader *head, buffioHeader *tail, size_t num) {
+  tail->next = finished.load(std::memory_order_relaxed);
+  while (!finished.compare_exchange_weak(tail->next, head,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed))
+    ;
+  batches.fetch_add(1, std::memory_order_relaxed);
+
+  state->queuedCompleted.fetch_add(num, std::memory_order_seq_cst);
+  // dropped before the wake check, a loop parked on these requests must
+  // be woken after the count it parked on is gone.
+  state->pendingReq.fetch_add(-(ssize_t)num, std::memory_order_seq_cst);
+
+  if (state->loopWakedUp.load(std::memory_order_seq_cst) == false) {
+    sendEv();
+    signals.fetch_add(1, std::memory_order_relaxed);
+  };
+};
+
+buffioHeader *sockBroker::detach() {
+  buffioHeader *list = finished.exchange(nullptr, std::memory_order_acquire);
+  // newest first, turned around so the routines resume in order.
+  buffioHeader *oldest = nullptr;
+  while (list != nullptr) {
+    buffioHeader *next = list->next;
+    list->next = oldest;
+    oldest = list;
+    list = next;
+  };
+  return oldest;
+};
+
+buffio::completionStats sockBroker::completions() const {
+  buffio::completionStats stats;
+  stats.completed = delivered;
+  stats.batches = batches.load(std::memory_order_relaxed);
+  stats.signals = signals.load(std::memory_order_relaxed);
+  return stats;
+};
+
+#define BUFFIO_WORKER_SPIN_MIN 64
+#define BUFFIO_WORKER_SPIN_MAX 16384
+
+bool sockBroker::park(long &spin) {
+  // a short spin first, a request landing meanwhile costs neither side a
+  // syscall. the length follows the hits like the loop's busy poll.
+  if (spin > 0) {
+    spinning.fetch_add(1, std::memory_order_seq_cst);
+    for (long i = 0; i < spin; i++) {
+      if (queued() ||
+          state->abort.load(std::memory_order_relaxed) < 0) {
+        spinning.fetch_add(-1, std::memory_order_seq_cst);
+        spinHits.fetch_add(1, std::memory_order_relaxed);
+        spin = spin * 2 > spinMax ? spinMax : spin * 2;
+        return true;
+      };
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    };
+  };
+  if (spinMax > 0)
+    spin = spin / 2 < BUFFIO_WORKER_SPIN_MIN ? BUFFIO_WORKER_SPIN_MIN
+                                              : spin / 2;
 
-    buffio::fiber::queuedCompleted.fetch_add(1,std::memory_order_acq_rel);
+  // counted as parked before leaving the spinners, the loop never sees
+  // the worker in neither.
+  uint32_t ticket = lot.prepare();
+  if (spinMax > 0)
+    spinning.fetch_add(-1, std::memory_order_seq_cst);
+  // the loop may have pushed before seeing us parked, and skipped the wake
+  if (queued() || state->abort.load(std::memory_order_seq_cst) < 0) {
+    lot.cancel();
+    return true;
+  };
 
-    if(buffio::fiber::loopWakedUp.load(std::memory_order_acquire) == false) 
-      parent->sendEv();
-     
+  long idle = idleMs.load(std::memory_order_relaxed);
+  if (idle <= 0)
+    return lot.park(ticket);
 
-    buffio::fiber::pendingReq.fetch_add(-1, std::memory_order_acq_rel);
+  struct timespec until;
+  ::clock_gettime(CLOCK_MONOTONIC, &until);
+  until.tv_sec += idle / 1000;
+  until.tv_nsec += (idle % 1000) * 1000000L;
+  if (until.tv_nsec >= 1000000000L) {
+    until.tv_sec += 1;
+    until.tv_nsec -= 1000000000L;
   };
-  buffio::fiber::workerCount.fetch_add(-1, std::memory_order_acq_rel);
+  return lot.park(ticket, &until);
+};
+
+void sockBroker::wake(size_t pushed) {
+  if (pushed == 0)
+    return;
+  // orders the queue publish before the counts load, pairs with the
+  // worker's prepare() and queued() recheck, else both sides can miss.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  ssize_t spinners = spinning.load(std::memory_order_seq_cst);
+  ssize_t parked = lot.waiting();
+  ssize_t need = (ssize_t)pushed - spinners;
+  if (need > parked)
+    need = parked;
 
+  // a post per request, up to the sleepers, is what a semaphore costs.
+  ssize_t sleepers = spinners + parked;
+  size_t posts = (ssize_t)pushed < sleepers ? pushed : sleepers;
+  size_t calls = 0;
+  if (need > 0) {
+    lot.wake((int)need);
+    calls = 1;
+    wakes.wakeCalls += 1;
+    wakes.woken += need;
+  };
+  if (posts > calls)
+    wakes.avoided += posts - calls;
+};
+
+buffio::parkingStats sockBroker::wakeStats() const {
+  buffio::parkingStats stats = wakes;
+  stats.spinHits = spinHits.load(std::memory_order_relaxed);
+  return stats;
+};
+
+bool sockBroker::claim() {
+  ssize_t left = depth.load(std::memory_order_relaxed);
+  while (left > 0) {
+    if (depth.compare_exchange_weak(left, left - 1,
+                                    std::memory_order_acq_rel))
+      return true;
+  };
+  return false;
+};
+
+bool sockBroker::retire() {
+  auto &live = state->workerCount;
+  size_t alive = live.load(std::memory_order_acquire);
+  int floor = retireFloor.load(std::memory_order_relaxed);
+  while (alive > (size_t)floor) {
+    if (!live.compare_exchange_weak(alive, alive - 1,
+                                    std::memory_order_seq_cst))
+      continue;
+    // queued while we timed out, the loop may have counted on us.
+    if (queued()) {
+      live.fetch_add(1, std::memory_order_seq_cst);
+      return false;
+    };
+    retired.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  };
+  return false;
+};
+
+int sockBroker::spawn() {
+  // counted before the thread runs, so scale() never spawns twice for the
+  // same backlog and shutWorker() waits for it.
+  state->workerCount.fetch_add(1, std::memory_order_acq_rel);
+  if (threads->run(nullptr, buffio::sockBroker::worker, this,
+                   buffio::thread::SD, {.cpu = -1, .node = node}) != 0) {
+    state->workerCount.fetch_add(-1, std::memory_order_acq_rel);
+    return (int)buffioErrorCode::threadRun;
+  };
   return 0;
 };
 
-int sockBroker::start(buffio::thread &thread, int &workerNum,
-                    size_t queueOrder) {
+int sockBroker::setScaling(const buffio::workerScaling &policy) {
+  if (policy.minWorkers < 1 || policy.maxWorkers < policy.minWorkers ||
+      policy.spawnAfterUs < 0 || policy.idleMs <= 0)
+    return (int)buffioErrorCode::workerNum;
+
+  scaling = policy;
+  bool on = elastic();
+  retireFloor.store(on ? policy.minWorkers : INT_MAX,
+                    std::memory_order_relaxed);
+  idleMs.store(on ? policy.idleMs : 0, std::memory_order_relaxed);
+  highSince = 0;
+  return 0;
+};
+
+void sockBroker::adjust() {
+  size_t gone = retired.load(std::memory_order_relaxed);
+  if (gone != reaped && threads != nullptr) {
+    reaped = gone;
+    threads->reap();
+  };
+  if (!elastic() || !running())
+    return;
+
+  size_t live = state->workerCount.load(std::memory_order_relaxed);
+  if (live > events.peak)
+    events.peak = live;
+  ssize_t queued = depth.load(std::memory_order_relaxed);
+  size_t perWorker = live > 0 ? live : 1;
+  if (live >= (size_t)scaling.maxWorkers ||
+      queued <= (ssize_t)(scaling.spawnDepth * perWorker)) {
+    highSince = 0;
+    return;
+  };
+
+  uint64_t nowNs = monotonicNs();
+  if (highSince == 0) {
+    highSince = nowNs;
+    return;
+  };
+  if (nowNs - highSince < (uint64_t)scaling.spawnAfterUs * 1000)
+    return;
+  // the next worker needs the backlog to stay high for another period.
+  highSince = 0;
+  if (spawn() == 0)
+    events.spawned += 1;
+};
+
+buffio::workerScalingStats sockBroker::scalingStats() const {
+  buffio::workerScalingStats stats = events;
+  stats.retired = retired.load(std::memory_order_relaxed);
+  return stats;
+};
+
+int sockBroker::start(buffio::thread &thread,
+                      buffio::fiber::loopState *loopState, int &workerNum,
+                      size_t queueOrder, int node) {
 
   size_t queueSizeRel = 1 << queueOrder;
   if (workerNum > queueSizeRel)
@@ -66,11 +334,13 @@ int sockBroker::start(buffio::thread &thread, int &workerNum,
   if (queueOrder < BUFFIO_RING_MIN || queueOrder > buffioatomix_max_order)
     return (int)buffioErrorCode::queueSize;
 
-  if (::sem_init(&buffioWorkerSignal,0, 0) != 0)
-    return -1;
+  if (loopState == nullptr)
+    return (int)buffioErrorCode::unknown;
 
-  if (epollConsume.lfstart(queueOrder) < 0)
-    goto outWithCleanUp;
+  // spinning only pays off when the loop runs on another cpu meanwhile.
+  spinMax = ::sysconf(_SC_NPROCESSORS_ONLN) > 1 ? BUFFIO_WORKER_SPIN_MAX : 0;
+
+  state = loopState;
 
   if (epollWorks.lfstart(queueOrder) < 0)
     goto outWithCleanUp;
@@ -78,12 +348,15 @@ int sockBroker::start(buffio::thread &thread, int &workerNum,
   if ((epollFd = ::epoll_create1(EPOLL_CLOEXEC)) < 0)
     goto outWithCleanUp;
 
+  threads = &thread;
+  this->node = node;
   for (int i = 0; i < workerNum; i++) {
-    if (thread.run(nullptr, buffio::sockBroker::worker, this) != 0) {
+    if (spawn() != 0) {
       workerNum = i + 1;
       return (int)buffioErrorCode::threadRun;
     }
   };
+  events.peak = (size_t)workerNum;
   sockBrokerState = buffioSockBrokerState::active;
 
   return (int)buffioErrorCode::none;
@@ -91,7 +364,6 @@ int sockBroker::start(buffio::thread &thread, int &workerNum,
 outWithEpoll:
   ::close(epollFd);
 outWithCleanUp:
-  epollConsume.~lfqueue();
   epollWorks.~lfqueue();
   return (int)buffioErrorCode::none;
 };
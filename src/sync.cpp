@@ -0,0 +1,147 @@
+#include "buffio/sync.hpp"
+#include "buffio/scheduler.hpp"
+#include <thread>
+
+using pstripped = buffio::promiseBase;
+
+namespace buffio {
+
+void syncGuard::lock() {
+  size_t spins = 0;
+  while (held.exchange(true, std::memory_order_acquire)) {
+    // the holder may be preempted, give it the cpu now and then.
+    while (held.load(std::memory_order_relaxed))
+      if ((++spins & 63) == 0)
+        std::this_thread::yield();
+  };
+};
+
+bool mutex::acquireOrPark(waitNode *node) {
+  // free means nobody is parked either, the mutex is ours then.
+  if (state.exchange(contended, std::memory_order_acquire) == unowned) {
+    if (waiters.empty())
+      state.store(owned, std::memory_order_relaxed);
+    return true;
+  };
+  waiters.push(node);
+  return false;
+};
+
+void mutex::unlock() {
+  int expected = owned;
+  if (state.compare_exchange_strong(expected, unowned,
+                                    std::memory_order_release,
+                                    std::memory_order_relaxed))
+    return;
+
+  // contended, the first parked routine gets the mutex without it ever
+  // being free.
+  guard.lock();
+  waitNode *node = waiters.pop();
+  if (waiters.empty())
+    state.store(owned, std::memory_order_release);
+  guard.unlock();
+  node->resume();
+};
+
+void semaphore::release(size_t permits) {
+  waitList woken;
+  guard.lock();
+  while (permits != 0 && !waiters.empty()) {
+    woken.push(waiters.pop());
+    permits -= 1;
+  };
+  if (permits != 0)
+    count.fetch_add((ssize_t)permits, std::memory_order_release);
+  guard.unlock();
+
+  while (!woken.empty())
+    woken.pop()->resume();
+};
+
+/*
+ * a notified routine takes the mutex back before running again, it goes
+ * to the wait list of the mutex if it is held.
+ */
+void condition::relock(waitNode *node) {
+  auto lock = node->relock;
+  lock->guard.lock();
+  bool owner = lock->acquireOrPark(node);
+  lock->guard.unlock();
+  if (owner)
+    node->resume();
+};
+
+void condition::notifyOne() {
+  guard.lock();
+  waitNode *node = waiters.empty() ? nullptr : waiters.pop();
+  guard.unlock();
+  if (node != nullptr)
+    relock(node);
+};
+
+void condition::notifyAll() {
+  guard.lock();
+  waitList woken = waiters;
+  waiters = {};
+  guard.unlock();
+
+  while (!woken.empty())
+    relock(woken.pop());
+};
+
+bool mutexAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+  lock->guard.lock();
+  // the node is only read by unlock() under the guard, so it can be
+  // queued before the entry is filled in.
+  bool owner = lock->acquireOrPark(&node);
+  if (!owner)
+    node.park();
+  lock->guard.unlock();
+  return !owner;
+};
+
+bool semaphoreAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+  sem->guard.lock();
+  if (sem->tryAcquire()) {
+    sem->guard.unlock();
+    return false;
+  };
+  node.park();
+  sem->waiters.push(&node);
+  sem->guard.unlock();
+  return true;
+};
+
+void conditionAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+  cond->guard.lock();
+  node.park();
+  cond->waiters.push(&node);
+  cond->guard.unlock();
+  // parked first, a notify following the unlock can't be missed.
+  node.relock->unlock();
+};
+
+}; // namespace buffio
+
+buffio::mutexAwaiter pstripped::await_transform(buffio::mutexLock op) {
+  bool owner = op.lock->tryLock();
+  return {.lock = op.lock, .node = {}, .ready = owner};
+};
+
+buffio::semaphoreAwaiter
+pstripped::await_transform(buffio::semaphoreAcquire op) {
+  bool permit = op.sem->tryAcquire();
+  return {.sem = op.sem, .node = {}, .ready = permit};
+};
+
+buffio::conditionAwaiter pstripped::await_transform(buffio::conditionWait op) {
+  return {.cond = op.cond,
+          .node = {.entry = nullptr,
+                   .loop = nullptr,
+                   .next = nullptr,
+                   .slot = nullptr,
+                   .relock = op.lock,
+                   .done = false,
+                   .pending = false}};
+};
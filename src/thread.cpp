@@ -1,4 +1,5 @@
 #include "buffio/thread.hpp"
+#include "buffio/topology.hpp"
 
 namespace buffio {
 thread::thread() {
@@ -36,8 +37,75 @@ void thread::free() {
   pthread_mutex_destroy(&buffioMutex);
   return;
 };
+void thread::join() {
+  if (mutexEnabled == false)
+    return;
+
+  ::pthread_mutex_lock(&buffioMutex);
+  auto *list = threads;
+  ::pthread_mutex_unlock(&buffioMutex);
+
+  for (auto *loop = list; loop != nullptr; loop = loop->next)
+    ::pthread_join(loop->id, NULL);
+};
+
+/*
+ * node of the placement, and the cpus the thread may run on, false if the
+ * placement leaves the thread free.
+ */
+static bool placementSet(buffio::threadPlacement where, cpu_set_t *set,
+                         int *node) {
+  *node = where.node;
+  if (where.cpu >= 0) {
+    if (*node < 0)
+      *node = buffio::topology::nodeOf(where.cpu);
+    CPU_ZERO(set);
+    CPU_SET(where.cpu, set);
+    return true;
+  };
+  return *node >= 0 && buffio::topology::cpusOf(*node, set) == 0;
+};
+
+int thread::pin(buffio::threadPlacement where) {
+  cpu_set_t set;
+  int node = -1;
+  if (!placementSet(where, &set, &node))
+    return node < 0 ? 0 : (int)buffioErrorCode::affinity;
+  if (::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) != 0)
+    return (int)buffioErrorCode::affinity;
+  // best effort, a kernel without numa keeps its default policy.
+  (void)buffio::topology::preferNode(node);
+  return 0;
+};
+
+size_t thread::reap() {
+  if (mutexEnabled == false)
+    return 0;
+
+  size_t reaped = 0;
+  ::pthread_mutex_lock(&buffioMutex);
+  for (auto **link = &threads; *link != nullptr;) {
+    auto *entry = *link;
+    if (entry->status.load(std::memory_order_acquire) !=
+        buffioThreadStatus::done) {
+      link = &entry->next;
+      continue;
+    };
+    // done is stored right before pthread_exit, the join is short.
+    ::pthread_join(entry->id, NULL);
+    *link = entry->next;
+    if (entry->name != nullptr)
+      delete[] entry->name;
+    ::free(entry->stack);
+    delete entry;
+    reaped += 1;
+  };
+  ::pthread_mutex_unlock(&buffioMutex);
+  return reaped;
+};
+
 int thread::run(const char *name, int (*func)(void *), void *data,
-                size_t stackSize) {
+                size_t stackSize, buffio::threadPlacement where) {
 
   assert(this != nullptr);
   if (stackSize < buffio::thread::S1KB || func == nullptr ||
@@ -63,6 +131,21 @@ int thread::run(const char *name, int (*func)(void *), void *data,
   tmpThr->stackSize = stackSize;
   tmpThr->numThreads = &numThreads;
   tmpThr->next = nullptr;
+  tmpThr->node = -1;
+
+  cpu_set_t cpus;
+  bool placed = placementSet(where, &cpus, &tmpThr->node);
+  if ((where.cpu >= 0 || where.node >= 0) && !placed) {
+    ::pthread_attr_destroy(&tmpThr->attr);
+    delete tmpThr;
+    return -1;
+  };
+  if (placed &&
+      ::pthread_attr_setaffinity_np(&tmpThr->attr, sizeof(cpus), &cpus) != 0) {
+    ::pthread_attr_destroy(&tmpThr->attr);
+    delete tmpThr;
+    return -1;
+  };
 
   if (::posix_memalign(&tmpThr->stack, sysconf(_SC_PAGESIZE), stackSize) != 0) {
     if (tmpThr->name != nullptr)
@@ -72,6 +155,9 @@ int thread::run(const char *name, int (*func)(void *), void *data,
     delete tmpThr;
     return -1;
   }
+  // untouched yet, its pages come from the node of the thread.
+  if (tmpThr->node >= 0)
+    (void)buffio::topology::bindMemory(tmpThr->stack, stackSize, tmpThr->node);
   if (::pthread_attr_setstack(&tmpThr->attr, tmpThr->stack, stackSize) != 0) {
     if (tmpThr->name != nullptr)
       delete tmpThr->name;
@@ -95,6 +181,8 @@ int thread::run(const char *name, int (*func)(void *), void *data,
     delete tmpThr;
     return -1;
   }
+  // the thread has its copy, the affinity set of the attr is freed here.
+  ::pthread_attr_destroy(&tmpThr->attr);
   /*
   if (name != nullptr) {
     size_t len = std::strlen(name);
@@ -120,6 +208,8 @@ void *thread::buffioFunc(void *data) {
   tmpThr->status.store(buffioThreadStatus::running, std::memory_order_release);
 
   tmpThr->numThreads->fetch_add(1, std::memory_order_acq_rel);
+  if (tmpThr->node >= 0)
+    (void)buffio::topology::preferNode(tmpThr->node);
 
   int mutexEnabled = tmpThr->func(tmpThr->resource);
 
@@ -0,0 +1,146 @@
+#include "buffio/topology.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace buffio {
+
+namespace {
+
+/*
+ * node of every cpu, filled once, nodes without cpus are counted but own
+ * no cpu.
+ */
+struct layout {
+  int nodes = 1;
+  short cpuNode[CPU_SETSIZE] = {};
+
+  layout() {
+    char path[64];
+    char list[4096];
+    int found = 0;
+    for (int node = 0; node < 1024; node++) {
+      std::snprintf(path, sizeof(path),
+                    "/sys/devices/system/node/node%d/cpulist", node);
+      if (!readList(path, list, sizeof(list))) {
+        // node ids can have holes, stop after a long gap.
+        if (node - found > 64)
+          break;
+        continue;
+      };
+      found = node + 1;
+      forEachCpu(list, [this, node](int cpu) { cpuNode[cpu] = (short)node; });
+    };
+    if (found > 0)
+      nodes = found;
+  };
+
+  static bool readList(const char *path, char *buffer, size_t size) {
+    FILE *file = std::fopen(path, "r");
+    if (file == nullptr)
+      return false;
+    bool ok = std::fgets(buffer, (int)size, file) != nullptr;
+    std::fclose(file);
+    return ok;
+  };
+
+  /*
+   * cpulist format: "0-3,8,10-11".
+   */
+  template <typename F> static void forEachCpu(const char *list, F each) {
+    const char *cursor = list;
+    while (*cursor != '\0' && *cursor != '\n') {
+      char *end = nullptr;
+      long first = std::strtol(cursor, &end, 10);
+      if (end == cursor)
+        return;
+      long last = first;
+      cursor = end;
+      if (*cursor == '-') {
+        last = std::strtol(cursor + 1, &end, 10);
+        cursor = end;
+      };
+      for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        if (cpu >= 0)
+          each((int)cpu);
+      if (*cursor == ',')
+        cursor++;
+    };
+  };
+};
+
+const layout &machine() {
+  static const layout instance;
+  return instance;
+};
+
+}; // namespace
+
+int topology::nodes() { return machine().nodes; };
+
+int topology::nodeOf(int cpu) {
+  if (cpu < 0 || cpu >= CPU_SETSIZE)
+    return 0;
+  return machine().cpuNode[cpu];
+};
+
+int topology::cpusOf(int node, cpu_set_t *set) {
+  auto &info = machine();
+  if (node < 0 || node >= info.nodes)
+    return -1;
+  CPU_ZERO(set);
+  long online = ::sysconf(_SC_NPROCESSORS_CONF);
+  for (long cpu = 0; cpu < online && cpu < CPU_SETSIZE; cpu++)
+    if (info.cpuNode[cpu] == node)
+      CPU_SET(cpu, set);
+  return CPU_COUNT(set) != 0 ? 0 : -1;
+};
+
+int topology::affinityNode() {
+  cpu_set_t set;
+  if (::pthread_getaffinity_np(::pthread_self(), sizeof(set), &set) != 0)
+    return -1;
+  int node = -1;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &set))
+      continue;
+    int owner = nodeOf(cpu);
+    if (node != -1 && owner != node)
+      return -1;
+    node = owner;
+  };
+  return node;
+};
+
+int topology::preferNode(int node) {
+  if (node < 0 || node >= nodes())
+    return -1;
+  // single node, the default policy places everything there already.
+  if (nodes() == 1)
+    return 0;
+  unsigned long mask[16] = {};
+  mask[node / (8 * sizeof(long))] = 1UL << (node % (8 * sizeof(long)));
+  if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                (unsigned long)(8 * sizeof(mask))) != 0)
+    return -1;
+  return 0;
+};
+
+int topology::bindMemory(void *addr, size_t len, int node) {
+  if (node < 0 || node >= nodes())
+    return -1;
+  if (nodes() == 1)
+    return 0;
+  unsigned long mask[16] = {};
+  mask[node / (8 * sizeof(long))] = 1UL << (node % (8 * sizeof(long)));
+  if (::syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask,
+                (unsigned long)(8 * sizeof(mask)), 0) != 0)
+    return -1;
+  return 0;
+};
+
+}; // namespace buffio
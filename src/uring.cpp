@@ -0,0 +1,484 @@
+#include "buffio/uring.hpp"
+
+#if defined(BUFFIO_IO_URING)
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define BUFFIO_URING_FILES 64
+
+#define uring_load(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define uring_store(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+namespace buffio {
+
+static inline int uringSetup(unsigned entries, io_uring_params *params) {
+  return (int)::syscall(__NR_io_uring_setup, entries, params);
+};
+static inline int uringEnter(int fd, unsigned submit, unsigned complete,
+                             unsigned flags) {
+  return (int)::syscall(__NR_io_uring_enter, fd, submit, complete, flags,
+                        nullptr, 0);
+};
+static inline int uringRegister(int fd, unsigned opcode, void *arg,
+                                unsigned nargs) {
+  return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+};
+
+uring::uring()
+    : ringFd(-1), sqHead(nullptr), sqTail(nullptr), sqMask(nullptr),
+      sqArray(nullptr), sqEntries(0), sqLocalTail(0), sqTailSubmitted(0),
+      sqes(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(nullptr),
+      cqes(nullptr), sqPtr(MAP_FAILED), cqPtr(MAP_FAILED), sqSize(0),
+      cqSize(0), sqesSize(0), inFlight(0), cancelSeq(0), filePos(false),
+      arena(nullptr), blockSize(0), blockNum(0) {};
+
+int uring::init(unsigned entries, int eventFd) {
+  if (ringFd >= 0)
+    return (int)buffioErrorCode::occupied;
+
+  io_uring_params params;
+  ::memset(&params, 0, sizeof(params));
+
+  if ((ringFd = uringSetup(entries, &params)) < 0) {
+    ringFd = -1;
+    return (int)buffioErrorCode::uringSetup;
+  };
+
+  sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+  sqPtr = ::mmap(nullptr, sqSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  cqPtr = ::mmap(nullptr, cqSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+  void *sqePtr = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+
+  if (sqPtr == MAP_FAILED || cqPtr == MAP_FAILED || sqePtr == MAP_FAILED) {
+    if (sqePtr != MAP_FAILED)
+      ::munmap(sqePtr, sqesSize);
+    release();
+    return (int)buffioErrorCode::uringSetup;
+  };
+
+  char *sq = (char *)sqPtr;
+  char *cq = (char *)cqPtr;
+  sqHead = (unsigned *)(sq + params.sq_off.head);
+  sqTail = (unsigned *)(sq + params.sq_off.tail);
+  sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+  sqArray = (unsigned *)(sq + params.sq_off.array);
+  sqEntries = params.sq_entries;
+  sqes = (io_uring_sqe *)sqePtr;
+  sqLocalTail = sqTailSubmitted = *sqTail;
+
+  cqHead = (unsigned *)(cq + params.cq_off.head);
+  cqTail = (unsigned *)(cq + params.cq_off.tail);
+  cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+  cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+  // every opcode used by the backend must be supported, or we fall back.
+  const unsigned char required[] = {IORING_OP_READ, IORING_OP_WRITE,
+                                    IORING_OP_ACCEPT, IORING_OP_CONNECT,
+                                    IORING_OP_POLL_ADD,
+                                    IORING_OP_ASYNC_CANCEL};
+  const size_t probeLen =
+      sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+  std::vector<char> probeMem(probeLen, 0);
+  auto *probe = (io_uring_probe *)probeMem.data();
+
+  if (uringRegister(ringFd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+    release();
+    return (int)buffioErrorCode::uringOp;
+  };
+  for (auto op : required) {
+    if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+      release();
+      return (int)buffioErrorCode::uringOp;
+    }
+  };
+
+  if (eventFd >= 0 &&
+      uringRegister(ringFd, IORING_REGISTER_EVENTFD, &eventFd, 1) < 0) {
+    release();
+    return (int)buffioErrorCode::uringSetup;
+  };
+
+  // files stay on the worker threads without these two.
+  filePos = (params.features & IORING_FEAT_RW_CUR_POS) != 0;
+  int sparse[BUFFIO_URING_FILES];
+  for (int &fd : sparse)
+    fd = -1;
+  if (uringRegister(ringFd, IORING_REGISTER_FILES, sparse,
+                    BUFFIO_URING_FILES) == 0)
+    fileSlots.assign(BUFFIO_URING_FILES, false);
+
+  return (int)buffioErrorCode::none;
+};
+
+void uring::release() {
+  if (sqes != nullptr)
+    ::munmap(sqes, sqesSize);
+  if (sqPtr != MAP_FAILED)
+    ::munmap(sqPtr, sqSize);
+  if (cqPtr != MAP_FAILED)
+    ::munmap(cqPtr, cqSize);
+  if (ringFd >= 0)
+    ::close(ringFd);
+  if (arena != nullptr)
+    ::munmap(arena, blockSize * blockNum);
+
+  sqes = nullptr;
+  sqPtr = cqPtr = MAP_FAILED;
+  ringFd = -1;
+  inFlight = 0;
+  stash.clear();
+  filePos = false;
+  fileSlots.clear();
+  arena = nullptr;
+  blockSize = blockNum = 0;
+  freeBlocks.clear();
+};
+
+int uring::registerFile(int fd) {
+  for (size_t i = 0; i < fileSlots.size(); i++) {
+    if (fileSlots[i])
+      continue;
+
+    io_uring_files_update update;
+    ::memset(&update, 0, sizeof(update));
+    update.offset = (unsigned)i;
+    update.fds = (uint64_t)(uintptr_t)&fd;
+    if (uringRegister(ringFd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+      return -1;
+    fileSlots[i] = true;
+    return (int)i;
+  };
+  return -1;
+};
+
+void uring::unregisterFile(int slot) {
+  if (slot < 0 || (size_t)slot >= fileSlots.size() || !fileSlots[slot])
+    return;
+
+  int fd = -1;
+  io_uring_files_update update;
+  ::memset(&update, 0, sizeof(update));
+  update.offset = (unsigned)slot;
+  update.fds = (uint64_t)(uintptr_t)&fd;
+  (void)uringRegister(ringFd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+  fileSlots[slot] = false;
+};
+
+int uring::registerBuffers(size_t size, size_t num) {
+  if (ringFd < 0)
+    return (int)buffioErrorCode::uringSetup;
+  if (arena != nullptr)
+    return (int)buffioErrorCode::occupied;
+  if (size == 0 || num == 0)
+    return (int)buffioErrorCode::none;
+
+  void *mem = ::mmap(nullptr, size * num, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    return (int)buffioErrorCode::uringBuffer;
+
+  std::vector<iovec> iov(num);
+  for (size_t i = 0; i < num; i++) {
+    iov[i].iov_base = (char *)mem + i * size;
+    iov[i].iov_len = size;
+  };
+
+  // fails when the arena is above RLIMIT_MEMLOCK, plain ops are used then.
+  if (uringRegister(ringFd, IORING_REGISTER_BUFFERS, iov.data(),
+                    (unsigned)num) < 0) {
+    ::munmap(mem, size * num);
+    return (int)buffioErrorCode::uringSetup;
+  };
+
+  arena = (char *)mem;
+  blockSize = size;
+  blockNum = num;
+  freeBlocks.reserve(num);
+  for (size_t i = num; i > 0; i--)
+    freeBlocks.push_back((unsigned)(i - 1));
+  return (int)buffioErrorCode::none;
+};
+
+char *uring::getBuffer() {
+  if (freeBlocks.empty())
+    return nullptr;
+  unsigned idx = freeBlocks.back();
+  freeBlocks.pop_back();
+  return arena + (size_t)idx * blockSize;
+};
+
+bool uring::putBuffer(char *buffer) {
+  if (arena == nullptr || buffer < arena ||
+      buffer >= arena + blockSize * blockNum)
+    return false;
+  freeBlocks.push_back((unsigned)((buffer - arena) / blockSize));
+  return true;
+};
+
+int uring::bufferIndex(const char *buffer, size_t len) const {
+  if (arena == nullptr || buffer < arena ||
+      buffer >= arena + blockSize * blockNum)
+    return -1;
+  size_t idx = (buffer - arena) / blockSize;
+  if ((size_t)(buffer - arena) + len > (idx + 1) * blockSize)
+    return -1;
+  return (int)idx;
+};
+
+io_uring_sqe *uring::getSqe() {
+  if (sqLocalTail - uring_load(sqHead) >= sqEntries) {
+    // ring is full, flush what we have before the batch point.
+    submit();
+    if (sqLocalTail - uring_load(sqHead) >= sqEntries)
+      return nullptr;
+  };
+
+  unsigned idx = sqLocalTail & *sqMask;
+  io_uring_sqe *sqe = &sqes[idx];
+  ::memset(sqe, 0, sizeof(io_uring_sqe));
+  sqArray[idx] = idx;
+  sqLocalTail += 1;
+  inFlight += 1;
+  return sqe;
+};
+
+static inline void prepare(io_uring_sqe *sqe, uint8_t op, int fd,
+                           uint64_t addr, uint32_t len, uint64_t offset,
+                           buffioHeader *header) {
+  sqe->opcode = op;
+  sqe->fd = fd;
+  sqe->addr = addr;
+  sqe->len = len;
+  sqe->off = offset;
+  sqe->user_data = (uint64_t)(uintptr_t)header;
+};
+
+int uring::prepareRw(buffioHeader *header, bool write, uint64_t offset,
+                     int slot) {
+  io_uring_sqe *sqe = getSqe();
+  if (sqe == nullptr)
+    return (int)buffioErrorCode::uringFull;
+
+  int idx = bufferIndex(header->data.buffer, header->len.len);
+  uint8_t op = 0;
+  if (idx >= 0)
+    op = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+  else
+    op = write ? IORING_OP_WRITE : IORING_OP_READ;
+
+  prepare(sqe, op, slot >= 0 ? slot : header->iFd,
+          (uint64_t)header->data.buffer, (uint32_t)header->len.len, offset,
+          header);
+  if (idx >= 0)
+    sqe->buf_index = (uint16_t)idx;
+  if (slot >= 0)
+    sqe->flags |= IOSQE_FIXED_FILE;
+  return 0;
+};
+
+int uring::read(buffioHeader *header, uint64_t offset, int slot) {
+  return prepareRw(header, false, offset, slot);
+};
+
+int uring::write(buffioHeader *header, uint64_t offset, int slot) {
+  return prepareRw(header, true, offset, slot);
+};
+
+int uring::accept(buffioHeader *header) {
+  io_uring_sqe *sqe = getSqe();
+  if (sqe == nullptr)
+    return (int)buffioErrorCode::uringFull;
+
+  uint64_t addrLen = 0;
+  if (header->data.socketaddr != nullptr)
+    addrLen = (uint64_t)&header->len.socklen;
+
+  prepare(sqe, IORING_OP_ACCEPT, header->iFd,
+          (uint64_t)header->data.socketaddr, 0, addrLen, header);
+  sqe->accept_flags = SOCK_CLOEXEC;
+  return 0;
+};
+
+int uring::connect(buffioHeader *header) {
+  io_uring_sqe *sqe = getSqe();
+  if (sqe == nullptr)
+    return (int)buffioErrorCode::uringFull;
+  prepare(sqe, IORING_OP_CONNECT, header->iFd,
+          (uint64_t)header->data.socketaddr, 0, header->len.socklen, header);
+  return 0;
+};
+
+int uring::pollAdd(buffioHeader *header, unsigned mask) {
+  io_uring_sqe *sqe = getSqe();
+  if (sqe == nullptr)
+    return (int)buffioErrorCode::uringFull;
+  prepare(sqe, IORING_OP_POLL_ADD, header->iFd, 0, 0, 0, header);
+  sqe->poll32_events = mask;
+  return 0;
+};
+
+int uring::submit() {
+  unsigned pending = sqLocalTail - uring_load(sqHead);
+  if (pending == 0)
+    return 0;
+
+  uring_store(sqTail, sqLocalTail);
+  sqTailSubmitted = sqLocalTail;
+
+  int ret = 0;
+  do {
+    ret = uringEnter(ringFd, pending, 0, 0);
+  } while (ret < 0 && errno == EINTR);
+
+  return ret < 0 ? -errno : ret;
+};
+
+// headers are aligned, an odd user_data is a cancel of uring::cancel and
+// never collides with a header nor with the 0 of uring::abort.
+static inline bool isHeader(uint64_t data) {
+  return data != 0 && (data & 1) == 0;
+};
+
+bool uring::reap(uint64_t *data, int *res) {
+  unsigned head = *cqHead;
+  if (head == uring_load(cqTail))
+    return false;
+
+  io_uring_cqe *cqe = &cqes[head & *cqMask];
+  *data = cqe->user_data;
+  *res = cqe->res;
+  uring_store(cqHead, head + 1);
+  inFlight -= 1;
+  return true;
+};
+
+void uring::cancel(buffioHeader *header) {
+  // reaped already by an earlier cancel, complete() must not hand it out
+  // once the header is gone.
+  if (std::erase_if(stash, [header](const stashed &entry) {
+        return entry.header == header;
+      }) != 0)
+    return;
+
+  cancelSeq += 1;
+  const uint64_t tag = (cancelSeq << 1) | 1;
+  bool submitted = false;
+  bool cancelled = false;
+  bool reaped = false;
+
+  // the caller frees the header after us, so we only leave once the kernel
+  // posted both its completion and the one of our cancel.
+  while (!reaped || (submitted && !cancelled)) {
+    if (!submitted) {
+      // a full queue the kernel refused to take, reaping below makes room.
+      io_uring_sqe *sqe = getSqe();
+      if (sqe != nullptr) {
+        prepare(sqe, IORING_OP_ASYNC_CANCEL, -1, (uint64_t)(uintptr_t)header,
+                0, 0, nullptr);
+        sqe->user_data = tag;
+        submit();
+        submitted = true;
+      };
+    };
+
+    uint64_t data = 0;
+    int res = 0;
+    if (!reap(&data, &res)) {
+      // errors (EINTR, EBUSY, ...) are retried, the header must not leak.
+      (void)uringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+      continue;
+    };
+
+    if (data == (uint64_t)(uintptr_t)header)
+      reaped = true;
+    else if (data == tag) {
+      cancelled = true;
+      // not in flight, its completion (if any) was reaped before ours.
+      if (res == -ENOENT)
+        reaped = true;
+    } else if (isHeader(data))
+      stash.push_back({(buffioHeader *)(uintptr_t)data, res});
+  };
+};
+
+int uring::abort(buffioHeader *header) {
+  io_uring_sqe *sqe = getSqe();
+  if (sqe == nullptr)
+    return -1;
+
+  // submitted with the next batch, its own completion carries no header.
+  prepare(sqe, IORING_OP_ASYNC_CANCEL, -1, (uint64_t)(uintptr_t)header, 0, 0,
+          nullptr);
+  return 0;
+};
+
+bool uring::complete(buffioHeader **header, int *res) {
+  if (!stash.empty()) {
+    *header = stash.front().header;
+    *res = stash.front().res;
+    stash.pop_front();
+    return true;
+  };
+
+  uint64_t data = 0;
+  while (reap(&data, res)) {
+    // completions of cancel requests carry no header.
+    if (isHeader(data)) {
+      *header = (buffioHeader *)(uintptr_t)data;
+      return true;
+    };
+  };
+  return false;
+};
+
+}; // namespace buffio
+
+#else
+
+namespace buffio {
+uring::uring()
+    : ringFd(-1), sqHead(nullptr), sqTail(nullptr), sqMask(nullptr),
+      sqArray(nullptr), sqEntries(0), sqLocalTail(0), sqTailSubmitted(0),
+      sqes(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(nullptr),
+      cqes(nullptr), sqPtr(nullptr), cqPtr(nullptr), sqSize(0), cqSize(0),
+      sqesSize(0), inFlight(0), cancelSeq(0), filePos(false), arena(nullptr),
+      blockSize(0), blockNum(0) {};
+int uring::init(unsigned entries, int eventFd) {
+  return (int)buffioErrorCode::pollerType;
+};
+void uring::release() {};
+int uring::read(buffioHeader *header, uint64_t offset, int slot) {
+  return -1;
+};
+int uring::write(buffioHeader *header, uint64_t offset, int slot) {
+  return -1;
+};
+int uring::registerFile(int fd) { return -1; };
+void uring::unregisterFile(int slot) {};
+int uring::registerBuffers(size_t size, size_t num) {
+  return (int)buffioErrorCode::pollerType;
+};
+char *uring::getBuffer() { return nullptr; };
+bool uring::putBuffer(char *buffer) { return false; };
+int uring::bufferIndex(const char *buffer, size_t len) const { return -1; };
+int uring::accept(buffioHeader *header) { return -1; };
+int uring::connect(buffioHeader *header) { return -1; };
+int uring::pollAdd(buffioHeader *header, unsigned mask) { return -1; };
+void uring::cancel(buffioHeader *header) {};
+int uring::abort(buffioHeader *header) { return -1; };
+int uring::submit() { return 0; };
+bool uring::complete(buffioHeader **header, int *res) { return false; };
+}; // namespace buffio
+
+#endif
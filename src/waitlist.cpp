@@ -0,0 +1,66 @@
+#include "buffio/waitlist.hpp"
+#include "buffio/scheduler.hpp"
+#include <thread>
+
+namespace buffio {
+
+void waitList::push(waitNode *node) {
+  node->next = nullptr;
+  if (tail != nullptr)
+    tail->next = node;
+  else
+    head = node;
+  tail = node;
+};
+
+waitNode *waitList::pop() {
+  waitNode *node = head;
+  head = node->next;
+  if (head == nullptr)
+    tail = nullptr;
+  return node;
+};
+
+void waitList::wake(bool done) {
+  waitNode *node = pop();
+  node->done = done;
+  node->resume();
+};
+
+void waitNode::park(bool counted) {
+  auto queue = buffio::fiber::queue;
+  entry = queue->get();
+  loop = buffio::fiber::loop;
+  pending = counted;
+  queue->erase();
+  if (counted)
+    buffio::fiber::state->pendingReq.fetch_add(1, std::memory_order_acq_rel);
+};
+
+/*
+ * run on the loop of the parked routine.
+ */
+static void requeue(void *data) {
+  buffio::fiber::queue->push((blockQueue *)data);
+};
+
+static void resumeParked(void *data) {
+  buffio::fiber::queue->push((blockQueue *)data);
+  buffio::fiber::state->pendingReq.fetch_add(-1, std::memory_order_acq_rel);
+};
+
+void waitNode::resume() {
+  // the frame holding the node may be gone once the routine is queued.
+  auto target = loop;
+  auto parked = entry;
+  auto resumed = pending ? resumeParked : requeue;
+  if (target == buffio::fiber::loop) {
+    resumed(parked);
+    return;
+  };
+  // the inbox drains every loop iteration, it is only full for a moment.
+  while (target->post(resumed, parked, parked->priority) != 0)
+    std::this_thread::yield();
+};
+
+}; // namespace buffio